@@ -5,285 +5,4005 @@
 #include <ctime>
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <charconv>
+#include <type_traits>
+#include <string_view>
+#include <utility>
+#include <unordered_map>
+#include <set>
+#include <deque>
+#include <condition_variable>
+#include <future>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <cstddef>
+#include <new>
 
 
 #ifdef PLATY_WINDOWS
+    // The min and max macros would break std::min and std::max
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
     #include <Windows.h>
     #define SET_COLOR(console, color) {SetConsoleTextAttribute(console, color);}
 #else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
+    #include <csignal>
+    #include <ctime>
+    #if defined(__linux__) && __has_include(<linux/io_uring.h>)
+        #include <linux/io_uring.h>
+        #include <sys/syscall.h>
+        #define PLATY_IO_URING
+    #endif
     #define SET_COLOR(console, color)
 #endif
 
+// Levels below this one are compiled out, define it as one of the Logger::LOGLEVEL_* values before including the header
+// The order is Trace, Info, Debug, Warning, Error, Fatal, so Debug can't be compiled out this way while Info stays
+// Calls through the PLATY_* macros below the level don't even evaluate their arguments
+#ifndef PLATY_MIN_LEVEL
+    #define PLATY_MIN_LEVEL Logger::LOGLEVEL_TRACE
+#endif
+
+// Levels that are compiled in, a combination of Logger::LOGLEVEL_* flags that can leave out any of them
+#ifndef PLATY_COMPILED_LEVELS
+    #define PLATY_COMPILED_LEVELS Logger::LOGLEVEL_ALL
+#endif
+
 /* Todo:
     - Comments and documentation (Maybe separate declaration and implementation for easier readability)
     - DONE - Selecting log levels to display and write to a file (Binary flags or extra fields)
     - (maybe) Create a logger message for errors and warnings
  */
 
-class Logger {
-public:
-    enum {
-        LOGLEVEL_NONE = 0,
-        LOGLEVEL_TRACE = 1,
-        LOGLEVEL_INFO = 1 << 1,
-        LOGLEVEL_DEBUG = 1 << 2,
-        LOGLEVEL_WARNING = 1 << 3,
-        LOGLEVEL_ERROR = 1 << 4,
-        LOGLEVEL_FATAL = 1 << 5,
-        LOGLEVEL_ALL = 63
-    };
+class Logger {
+public:
+    enum {
+        LOGLEVEL_NONE = 0,
+        LOGLEVEL_TRACE = 1,
+        LOGLEVEL_INFO = 1 << 1,
+        LOGLEVEL_DEBUG = 1 << 2,
+        LOGLEVEL_WARNING = 1 << 3,
+        LOGLEVEL_ERROR = 1 << 4,
+        LOGLEVEL_FATAL = 1 << 5,
+        LOGLEVEL_ALL = 63
+    };
+
+    // When the file buffer gets written to the disk
+    enum {
+        FLUSH_EVERY_LINE = 1,
+        FLUSH_EVERY_N_BYTES = 1 << 1,
+        FLUSH_INTERVAL = 1 << 2,
+        FLUSH_ON_ERROR = 1 << 3,
+        FLUSH_DURABLE = 1 << 4 // FILESINK_URING only, flushes also fdatasync the file
+    };
+
+    // How latest_log.txt is written
+    enum {
+        FILEFORMAT_TEXT = 0,
+        FILEFORMAT_BINARY
+    };
+
+    // What writes latest_log.txt
+    enum {
+        FILESINK_STREAM = 0,
+        FILESINK_MMAP, // POSIX only, falls back to FILESINK_STREAM elsewhere
+        FILESINK_URING // POSIX only, uses io_uring on Linux and plain writes elsewhere
+    };
+
+    // What a message does when the async queue or its thread buffer is full
+    enum {
+        OVERFLOW_BLOCK = 0, // Waits for the writer
+        OVERFLOW_DROP_NEWEST, // The message is dropped
+        OVERFLOW_DROP_OLDEST, // The oldest queued message is dropped to make room, unless its own level blocks
+        OVERFLOW_OVERWRITE // The oldest queued message is dropped to make room, whatever its level
+    };
+
+    // Wall clock boundaries at which the log file is rotated
+    enum {
+        ROTATE_NONE = 0,
+        ROTATE_HOURLY,
+        ROTATE_DAILY
+    };
+
+    // Resolution of the timestamp in the message header
+    enum {
+        TIMESTAMP_SECONDS = 0,
+        TIMESTAMP_MILLISECONDS,
+        TIMESTAMP_MICROSECONDS
+    };
+
+    // Everything Init sets up, the defaults are the same as when the logger isn't initialized
+    struct Config
+    {
+        unsigned int levelsToDisplay = LOGLEVEL_ALL;
+        unsigned int levelsToSave = LOGLEVEL_ALL;
+        unsigned int pastLogsToKeep = 5;
+        uint64_t retentionBytes = 0;
+        std::chrono::seconds retentionAge = std::chrono::seconds(0);
+        uint64_t minimumFreeSpace = 0;
+        bool compressArchives = false;
+
+        unsigned int fileFormat = FILEFORMAT_TEXT;
+        unsigned int fileSink = FILESINK_STREAM;
+        size_t mmapWindowSize = 16 * 1024 * 1024;
+        unsigned int timestampPrecision = TIMESTAMP_SECONDS;
+        size_t fileBufferSize = 64 * 1024;
+        unsigned int flushPolicy = FLUSH_EVERY_LINE | FLUSH_ON_ERROR;
+        size_t flushBytes = 0;
+        std::chrono::milliseconds flushInterval = std::chrono::milliseconds(0);
+        uint64_t rotationSize = 0;
+        unsigned int rotationInterval = ROTATE_NONE;
+
+        size_t asyncQueueSize = 0; // 0 keeps logging synchronous
+        size_t threadBufferSize = 0;
+        bool deferredFormatting = false;
+        bool suppressDuplicates = false;
+        // Levels that don't wait for a full queue, see the OVERFLOW_* values, everything else blocks
+        unsigned int dropNewestLevels = LOGLEVEL_NONE;
+        unsigned int dropOldestLevels = LOGLEVEL_NONE;
+        unsigned int overwriteLevels = LOGLEVEL_NONE;
+
+        // Empty leaves the flight recorder off
+        std::string flightRecorderPath;
+        size_t flightRecorderRecords = 4096;
+        unsigned int flightRecorderLevels = LOGLEVEL_ALL;
+
+        // Archives the previous log and opens the new one on a background thread, messages logged before it is done wait for it
+        bool initInBackground = false;
+    };
+
+    // Applies the config and does everything the first message would otherwise do: creating the directories,
+    // archiving the previous log, loading the past logs and opening latest_log.txt
+    // Call it once at startup before logging from other threads
+    [[maybe_unused]]static void Init(const Config& config)
+    {
+        SetLevelsToDisplay(config.levelsToDisplay);
+        SetLevelsToSave(config.levelsToSave);
+        SetNumberOfFilesToSave(config.pastLogsToKeep);
+        SetRetentionBytes(config.retentionBytes);
+        SetRetentionAge(config.retentionAge);
+        SetMinimumFreeSpace(config.minimumFreeSpace);
+        SetArchiveCompression(config.compressArchives);
+        SetFileFormat(config.fileFormat);
+        SetFileSink(config.fileSink, config.mmapWindowSize);
+        SetTimestampPrecision(config.timestampPrecision);
+        SetFileBufferSize(config.fileBufferSize);
+        SetFlushPolicy(config.flushPolicy, config.flushBytes, config.flushInterval);
+        SetRotationSize(config.rotationSize);
+        SetRotationInterval(config.rotationInterval);
+        SetDeferredFormatting(config.deferredFormatting);
+        SetDuplicateSuppression(config.suppressDuplicates);
+        SetOverflowPolicy(LOGLEVEL_ALL, OVERFLOW_BLOCK);
+        SetOverflowPolicy(config.dropNewestLevels, OVERFLOW_DROP_NEWEST);
+        SetOverflowPolicy(config.dropOldestLevels, OVERFLOW_DROP_OLDEST);
+        SetOverflowPolicy(config.overwriteLevels, OVERFLOW_OVERWRITE);
+        if(!config.flightRecorderPath.empty())
+            EnableFlightRecorder(config.flightRecorderPath, config.flightRecorderRecords, config.flightRecorderLevels);
+
+        if(config.initInBackground)
+        {
+            // Waits until the thread holds the mutex so no message can get to the file before it's set up
+            std::promise<void> locked;
+            std::future<void> isLocked = locked.get_future();
+            initThread = std::thread([](std::promise<void> lockTaken)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                lockTaken.set_value();
+                InitLogFile();
+            }, std::move(locked));
+            isLocked.wait();
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            InitLogFile();
+        }
+
+        if(config.asyncQueueSize > 0 || config.threadBufferSize > 0)
+            EnableAsyncLogging(config.asyncQueueSize > 0 ? config.asyncQueueSize : 8192, config.threadBufferSize);
+    }
+
+    // Levels to display int he console
+    [[maybe_unused]]static void SetLevelsToDisplay(unsigned int logLevels)
+    {
+        logLevelsToDisplay.store(logLevels, std::memory_order_relaxed);
+        UpdateEnabledLevels();
+    }
+
+    // Levels to save into log files
+    [[maybe_unused]]static void SetLevelsToSave(unsigned int logLevels)
+    {
+        logLevelsToSave.store(logLevels, std::memory_order_relaxed);
+        UpdateEnabledLevels();
+    }
+
+    [[maybe_unused]]static void SetNumberOfFilesToSave(unsigned int numberToSave)
+    {
+        pastLogsToKeep = numberToSave;
+    }
+
+    // Whether the level is at or above PLATY_MIN_LEVEL and in PLATY_COMPILED_LEVELS
+    static constexpr bool IsLevelCompiled(int logLevel)
+    {
+        return logLevel >= PLATY_MIN_LEVEL && (logLevel & (PLATY_COMPILED_LEVELS)) != 0;
+    }
+
+    // Call site counters of the sampling macros, a skipped call costs one relaxed atomic operation
+    // An n of 0 never logs, like FirstN
+    static bool EveryN(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        return n != 0 && counter.fetch_add(1, std::memory_order_relaxed) % n == 0;
+    }
+
+    static bool FirstN(std::atomic<uint64_t>& counter, uint64_t n)
+    {
+        // Only reads the counter once it's past n, so skipped calls from different threads don't fight over the cache line
+        return counter.load(std::memory_order_relaxed) < n && counter.fetch_add(1, std::memory_order_relaxed) < n;
+    }
+
+    // Needs a clock read as well, only the thread that moves the deadline gets to log
+    static bool EveryInterval(std::atomic<int64_t>& next, std::chrono::steady_clock::duration interval)
+    {
+        int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        int64_t due = next.load(std::memory_order_relaxed);
+        return now >= due && next.compare_exchange_strong(due, now + interval.count(), std::memory_order_relaxed);
+    }
+
+    [[maybe_unused]]static void SetTimestampPrecision(unsigned int precision)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        timestampPrecision = precision;
+    }
+
+    // FILEFORMAT_BINARY writes every format string once and then only the arguments of each message
+    // Takes effect with the next log file, decode binary logs with DecodeBinaryLog or the PlatyLogDecode tool
+    [[maybe_unused]]static void SetFileFormat(unsigned int format)
+    {
+        fileFormat.store(format, std::memory_order_relaxed);
+    }
+
+    // Turns a binary log file back into the text format, returns false if the input isn't a complete binary log
+    [[maybe_unused]]static bool DecodeBinaryLog(std::istream& in, std::ostream& out)
+    {
+        std::string creationDate;
+        std::getline(in, creationDate);
+
+        char start[sizeof(binaryMagic) + 9];
+        if(!in.read(start, sizeof(start)) || memcmp(start, binaryMagic, sizeof(binaryMagic) - 1) != 0)
+            return false;
+
+        unsigned int precision = (unsigned char)start[sizeof(binaryMagic) - 1];
+        uint64_t timestamp = 0;
+        for(int i = 7; i >= 0; i--)
+            timestamp = (timestamp << 8) | (unsigned char)start[sizeof(binaryMagic) + i];
+
+        out << creationDate << "\n\n";
+
+        std::vector<std::string> formats;
+        std::string strings;
+        int tag;
+        while((tag = in.get()) != EOF)
+        {
+            // Preallocated space of a log that wasn't closed properly
+            if(tag == '\0')
+                break;
+
+            if(tag == BINARY_FORMAT)
+            {
+                uint64_t id, length;
+                if(!ReadVarint(in, id) || !ReadVarint(in, length) || id > formats.size() || length > (1u << 20))
+                    return false;
+                std::string format(length, '\0');
+                if(!in.read(format.data(), (std::streamsize)length))
+                    return false;
+                if(id == formats.size())
+                    formats.push_back(std::move(format));
+                else
+                    formats[id] = std::move(format);
+                continue;
+            }
+
+            if(tag != BINARY_RECORD)
+                return false;
+
+            int logLevel = in.get();
+            uint64_t delta, formatId, argCount;
+            if(logLevel == EOF || !ReadVarint(in, delta) || !ReadVarint(in, formatId) || !ReadVarint(in, argCount)
+               || formatId >= formats.size() || argCount > 64)
+                return false;
+            timestamp += delta;
+
+            FormatArg args[64];
+            if(!DecodeArgs(in, args, argCount, strings))
+                return false;
+
+            char message[sizeof(LogRecord::message)];
+            FormatBuffer buffer(message, sizeof(message));
+            FormatMessage(buffer, formats[formatId].c_str(), args, argCount);
+            buffer.Terminate();
+
+            char header[48];
+            FormatHeader(header, timestamp, LevelName(logLevel), precision);
+            out << header << " - " << message << "\n";
+        }
+
+        return true;
+    }
+
+    // FILESINK_MMAP preallocates the log file and appends to a memory mapped window of windowSize bytes
+    // instead of going through the file buffer, FILESINK_URING writes the file buffer in the background
+    // Takes effect with the next log file
+    [[maybe_unused]]static void SetFileSink(unsigned int sink, size_t windowSize = 16 * 1024 * 1024)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fileSink = sink;
+        if(!IsLogFileOpen())
+        {
+            // Whole pages, so every window starts at an offset mmap accepts
+            size_t pageSize = 64 * 1024;
+            mmapWindowSize = std::max(pageSize, windowSize - windowSize % pageSize);
+        }
+    }
+
+    // Archives latest_log.txt and starts a new one once it reaches this many bytes, 0 turns it off
+    [[maybe_unused]]static void SetRotationSize(uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rotationSize = bytes;
+        if(IsLogFileOpen())
+            rotateAtBytes = bytes > 0 ? bytes : UINT64_MAX;
+    }
+
+    // Archives latest_log.txt and starts a new one every hour or day (ROTATE_*)
+    [[maybe_unused]]static void SetRotationInterval(unsigned int interval)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rotationInterval = interval;
+        if(IsLogFileOpen())
+        {
+            uint64_t written = fileBytesWritten;
+            UpdateRotationLimits();
+            fileBytesWritten = written;
+        }
+    }
+
+    // Compresses logs moved into past_logs on a background thread, they end up as <name>.txt.plz
+    [[maybe_unused]]static void SetArchiveCompression(bool compress)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        archiveCompression = compress;
+    }
+
+    // Turns a compressed archive back into the original log, returns false if the input is corrupt
+    [[maybe_unused]]static bool DecompressArchive(std::istream& in, std::ostream& out)
+    {
+        char magic[sizeof(compressedMagic) - 1];
+        if(!in.read(magic, sizeof(magic)) || memcmp(magic, compressedMagic, sizeof(magic)) != 0)
+            return false;
+
+        std::unique_ptr<unsigned char[]> stored(new unsigned char[compressionBlockSize]);
+        std::unique_ptr<unsigned char[]> raw(new unsigned char[compressionBlockSize]);
+        for(;;)
+        {
+            char sizes[8];
+            if(!in.read(sizes, sizeof(sizes)))
+                return false;
+
+            uint32_t rawSize = ReadFixed32(sizes);
+            uint32_t storedSize = ReadFixed32(sizes + 4);
+            if(rawSize == 0)
+                return true;
+
+            size_t dataSize = storedSize & ~storedRawFlag;
+            if(rawSize > compressionBlockSize || dataSize > compressionBlockSize || !in.read((char*)stored.get(), (std::streamsize)dataSize))
+                return false;
+
+            if((storedSize & storedRawFlag) != 0)
+            {
+                out.write((const char*)stored.get(), (std::streamsize)dataSize);
+                continue;
+            }
+
+            if(DecompressBlock(stored.get(), dataSize, raw.get(), rawSize) != rawSize)
+                return false;
+            out.write((const char*)raw.get(), rawSize);
+        }
+    }
+
+    // Size of the buffer the log file is written through
+    [[maybe_unused]]static void SetFileBufferSize(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        FlushFileBuffer();
+        fileBufferCapacity = bytes;
+        fileBuffer.resize(bytes);
+    }
+
+    // Combination of FLUSH_* flags, flushBytes and interval are used by FLUSH_EVERY_N_BYTES and FLUSH_INTERVAL
+    // Without async logging nothing runs between messages, so FLUSH_INTERVAL is only checked when the next line is written
+    [[maybe_unused]]static void SetFlushPolicy(unsigned int policy, size_t bytes = 0, std::chrono::milliseconds interval = std::chrono::milliseconds(0))
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushPolicy = policy;
+        flushBytes = bytes;
+        flushInterval = interval;
+    }
+
+    // Removes the oldest past logs once all of them together would take more than this many bytes, 0 turns it off
+    [[maybe_unused]]static void SetRetentionBytes(uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        retentionBytes = bytes > 0 ? bytes : UINT64_MAX;
+    }
+
+    // Removes past logs older than this, 0 turns it off
+    [[maybe_unused]]static void SetRetentionAge(std::chrono::seconds age)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        retentionAge = age;
+    }
+
+    // Removes the oldest past logs while the disk has less free space than this, 0 turns it off
+    [[maybe_unused]]static void SetMinimumFreeSpace(uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        minimumFreeSpace = bytes;
+    }
+
+    // What messages of the levels do when the queue is full, dropped messages are counted and the writer reports them
+    // as a Warning at most once per second. Thread buffers can only be emptied by the writer, so with them
+    // OVERFLOW_DROP_OLDEST and OVERFLOW_OVERWRITE drop the new message instead
+    [[maybe_unused]]static void SetOverflowPolicy(unsigned int levels, unsigned int policy)
+    {
+        for(int i = 0; i < levelCount; i++)
+        {
+            if((levels & (1 << i)) != 0)
+                overflowPolicies[i].store(policy, std::memory_order_relaxed);
+        }
+    }
+
+    // Starts a writer thread, after this logging calls only enqueue their message
+    // With threadBufferSize set every logging thread gets its own buffer of that many messages instead of sharing
+    // the queue, the writer merges them by timestamp. Sizes are rounded up to a power of two
+    [[maybe_unused]]static void EnableAsyncLogging(size_t queueSize = 8192, size_t threadBufferSize = 0)
+    {
+        if(asyncEnabled.load(std::memory_order_acquire))
+            return;
+
+        threadBufferMask = threadBufferSize > 0 ? RoundUpToPowerOfTwo(threadBufferSize) - 1 : 0;
+        usePerThreadBuffers.store(threadBufferSize > 0, std::memory_order_relaxed);
+
+        size_t capacity = RoundUpToPowerOfTwo(queueSize);
+        queue.reset(new QueueCell[capacity]);
+        for(size_t i = 0; i < capacity; i++)
+            queue[i].sequence.store(i, std::memory_order_relaxed);
+        queueMask = capacity - 1;
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+
+        writerRunning.store(true, std::memory_order_relaxed);
+        writerThread = std::thread(WriterLoop);
+        asyncEnabled.store(true, std::memory_order_release);
+    }
+
+    // Writes out everything still in the queue and stops the writer thread
+    // Logging calls made after this are synchronous again
+    [[maybe_unused]]static void DisableAsyncLogging()
+    {
+        if(!asyncEnabled.exchange(false, std::memory_order_seq_cst))
+            return;
+
+        // Calls that still saw async mode on finish their message first, the writer keeps emptying the queue and the buffers meanwhile
+        while(asyncProducers.load(std::memory_order_seq_cst) != 0)
+            std::this_thread::yield();
+        {
+            std::lock_guard<std::mutex> lock(threadOwnersMutex);
+            for(ThreadBufferOwner* owner : threadOwners)
+            {
+                while(owner->producing.load(std::memory_order_seq_cst))
+                    std::this_thread::yield();
+            }
+        }
+
+        writerRunning.store(false, std::memory_order_release);
+        if(writerThread.joinable())
+            writerThread.join();
+
+        queue.reset();
+
+        std::lock_guard<std::mutex> lock(threadBuffersMutex);
+        threadBuffers.clear();
+        threadBuffersGeneration++;
+    }
+
+    // In asynchronous mode the arguments are only copied by the logging call and formatted by the writer thread
+    // The format strings have to outlive the call (string literals), arguments of user types are still formatted right away
+    [[maybe_unused]]static void SetDeferredFormatting(bool deferred)
+    {
+        deferredFormatting.store(deferred, std::memory_order_relaxed);
+    }
+
+    // Collapses runs of the same message (same level, format and arguments) into the first one and a line with the
+    // number of repeats and the time they span. The line is written when a different message comes, at most a second
+    // after the first one of the run, on Flush and at shutdown
+    [[maybe_unused]]static void SetDuplicateSuppression(bool suppress)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!suppress)
+            ReportRepeatedRecords();
+        suppressDuplicates = suppress;
+        lastRecordHash = 0;
+    }
+
+    // Keeps the last recordCount messages of the levels in a memory mapped file, whether they are displayed or saved or not
+    // It is written by the logging thread itself, so it has everything up to the moment the process died
+    // The previous recording is moved to <path>.old, decode it with DecodeFlightRecorder or the PlatyLogDecode tool
+    // POSIX only, returns false elsewhere or if the file can't be set up
+    [[maybe_unused]]static bool EnableFlightRecorder([[maybe_unused]]const std::string& path, [[maybe_unused]]size_t recordCount = 4096, [[maybe_unused]]unsigned int levels = LOGLEVEL_ALL)
+    {
+#ifdef PLATY_WINDOWS
+        return false;
+#else
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // A power of two so the slot of a record is found with a mask
+        size_t count = 1;
+        while(count < recordCount)
+            count <<= 1;
+        size_t size = flightHeaderSize + count * flightRecordSize;
+
+        std::error_code error;
+        if(std::filesystem::exists(path, error))
+            std::filesystem::rename(path, path + ".old", error);
+
+        int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(file < 0)
+            return false;
+        void* map = posix_fallocate(file, 0, (off_t)size) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+        ::close(file);
+        if(map == MAP_FAILED)
+            return false;
+
+        FlightHeader* header = new(map) FlightHeader();
+        memcpy(header->magic, flightMagic, sizeof(header->magic));
+        header->recordSize = (uint32_t)flightRecordSize;
+        header->recordCount = (uint32_t)count;
+        header->precision = timestampPrecision;
+
+        flightRecorder.store(header, std::memory_order_release);
+        flightRecorderLevels.store(levels, std::memory_order_relaxed);
+        UpdateEnabledLevels();
+        return true;
+#endif
+    }
+
+    // Stops recording, the file keeps what was recorded
+    // It stays mapped until the process exits since other threads may still be finishing a record in it
+    [[maybe_unused]]static void DisableFlightRecorder()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        flightRecorderLevels.store(LOGLEVEL_NONE, std::memory_order_relaxed);
+        UpdateEnabledLevels();
+        flightRecorder.store(nullptr, std::memory_order_release);
+    }
+
+    // Turns a flight recorder file into the text format, oldest record first
+    [[maybe_unused]]static bool DecodeFlightRecorder(std::istream& in, std::ostream& out)
+    {
+        char header[flightHeaderSize];
+        if(!in.read(header, sizeof(header)) || memcmp(header, flightMagic, sizeof(flightMagic) - 1) != 0)
+            return false;
+
+        uint32_t recordSize, recordCount, precision;
+        memcpy(&recordSize, header + offsetof(FlightHeader, recordSize), sizeof(recordSize));
+        memcpy(&recordCount, header + offsetof(FlightHeader, recordCount), sizeof(recordCount));
+        memcpy(&precision, header + offsetof(FlightHeader, precision), sizeof(precision));
+        if(recordSize <= sizeof(FlightRecord) || recordSize > (1u << 16) || recordCount == 0 || (recordCount & (recordCount - 1)) != 0 || recordCount > (1u << 24))
+            return false;
+
+        std::vector<char> slots((size_t)recordSize * recordCount);
+        if(!in.read(slots.data(), (std::streamsize)slots.size()))
+            return false;
+
+        // Only finished records that are in their own slot, a slot that was being written when the process died is skipped
+        std::vector<std::pair<uint64_t, const char*>> records;
+        for(size_t i = 0; i < recordCount; i++)
+        {
+            const char* slot = slots.data() + i * recordSize;
+            uint64_t sequence;
+            memcpy(&sequence, slot + offsetof(FlightRecord, sequence), sizeof(sequence));
+            if(sequence != 0 && ((sequence - 1) & (recordCount - 1)) == i)
+                records.emplace_back(sequence, slot);
+        }
+        std::sort(records.begin(), records.end());
+
+        std::string strings;
+        for(const auto& [sequence, slot] : records)
+        {
+            uint64_t timestamp;
+            uint16_t length;
+            memcpy(&timestamp, slot + offsetof(FlightRecord, timestamp), sizeof(timestamp));
+            memcpy(&length, slot + offsetof(FlightRecord, length), sizeof(length));
+            int logLevel = (unsigned char)slot[offsetof(FlightRecord, logLevel)];
+            if(length > recordSize - sizeof(FlightRecord))
+                continue;
+
+            MemoryBuffer memory(slot + sizeof(FlightRecord), length);
+            std::istream record(&memory);
+            uint64_t formatLength;
+            if(!ReadVarint(record, formatLength) || formatLength > length)
+                continue;
+            std::string format(formatLength, '\0');
+            record.read(format.data(), (std::streamsize)formatLength);
+
+            FormatArg args[64];
+            int argCount = record.get();
+            if(argCount == EOF || argCount > 64 || !DecodeArgs(record, args, (uint64_t)argCount, strings))
+                continue;
+
+            char message[sizeof(LogRecord::message)];
+            FormatBuffer buffer(message, sizeof(message));
+            FormatMessage(buffer, format.c_str(), args, (size_t)argCount);
+            buffer.Terminate();
+
+            char text[48];
+            FormatHeader(text, timestamp, LevelName(logLevel), precision);
+            out << text << " - " << message << "\n";
+        }
+
+        return true;
+    }
+
+    // Blocks until every message logged before this call has been written to the disk
+    [[maybe_unused]]static void Flush()
+    {
+        // Counted like a logging call, so the thread buffers it waits on aren't freed under it
+        AsyncProducer producer;
+        if(producer.entered)
+        {
+            size_t target = enqueuePos.load(std::memory_order_acquire);
+            while(dequeuePos.load(std::memory_order_acquire) < target)
+                std::this_thread::yield();
+
+            // Waits for each thread buffer to get past the point it was at when Flush was called
+            // The writer doesn't free the buffers of exited threads while someone waits on them
+            std::vector<std::pair<ThreadBuffer*, size_t>> targets;
+            {
+                std::lock_guard<std::mutex> lock(threadBuffersMutex);
+                flushingThreads++;
+                for(const auto& buffer : threadBuffers)
+                    targets.emplace_back(buffer.get(), buffer->head.load(std::memory_order_acquire));
+            }
+            for(const auto& [buffer, head] : targets)
+            {
+                while(buffer->tail.load(std::memory_order_acquire) < head)
+                    std::this_thread::yield();
+            }
+            {
+                std::lock_guard<std::mutex> lock(threadBuffersMutex);
+                flushingThreads--;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ReportRepeatedRecords();
+        FlushFileBuffer();
+    }
+
+    // On SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT writes out everything that was logged but is still waiting
+    // in the queue, the thread buffers or the file buffer, then hands the signal to the handler that was there before
+    // Nothing is written after that, the process is expected to end. POSIX only
+    // The handler runs on an alternate stack so it works after a stack overflow, threads that never log don't have one
+    [[maybe_unused]]static void InstallCrashHandler()
+    {
+#ifndef PLATY_WINDOWS
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = HandleCrashSignal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_ONSTACK;
+        for(size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]); i++)
+            sigaction(crashSignals[i], &action, &previousCrashHandlers[i]);
+
+        // Other threads get theirs when they first log
+        crashHandlerInstalled.store(true, std::memory_order_relaxed);
+        SetUpCrashStack();
+#endif
+    }
+
+private:
+    // Lets the programs in bench/ time the formatting functions on their own
+    friend struct LoggerBenchmark;
+
+    static void* console;
+    static const unsigned int traceColor;
+    static const unsigned int infoColor;
+    static const unsigned int debugColor;
+    static const unsigned int warnColor;
+    static const unsigned int errorColor;
+    static const unsigned int fatalColor;
+
+    static const std::string latestLogFilepath;
+    static const std::string pastLogsFilepath;
+    static const std::string logsFilepath;
+    static bool shouldCreateNewFile;
+    static bool loggingDirectoriesCreated;
+    static unsigned int pastLogsToKeep;
+    static time_t currentFileCreated;
+
+    // Archived log in past_logs, ordered from the oldest to the newest
+    struct ArchivedLog
+    {
+        time_t created;
+        int suffix;
+        std::string path;
+        uint64_t size;
+
+        bool operator<(const ArchivedLog& other) const
+        {
+            if(created != other.created)
+                return created < other.created;
+            if(suffix != other.suffix)
+                return suffix < other.suffix;
+            return path < other.path;
+        }
+    };
+    static std::set<ArchivedLog> archiveIndex;
+    static bool archiveIndexLoaded;
+    static uint64_t archiveBytes;
+
+    static uint64_t retentionBytes;
+    static std::chrono::seconds retentionAge;
+    static uint64_t minimumFreeSpace;
+
+    static bool archiveCompression;
+    static std::thread compressionThread;
+    static std::mutex compressionMutex;
+    static std::condition_variable compressionCondition;
+    static std::deque<ArchivedLog> compressionJobs;
+    static std::atomic<bool> compressionRunning;
+
+    static uint64_t rotationSize;
+    static unsigned int rotationInterval;
+    static uint64_t fileBytesWritten;
+    static uint64_t rotateAtBytes;
+    static uint64_t rotateAtTime;
+
+    static std::mutex mutex;
+    static std::fstream fs;
+    static std::vector<char> fileBuffer;
+    static unsigned int fileSink;
+    static unsigned int openFileSink;
+    static int logFile;
+    static uint64_t fileOffset;
+#ifdef PLATY_IO_URING
+    static constexpr unsigned int uringEntries = 16;
+    static constexpr size_t uringBufferCount = 4;
+    struct IoUring
+    {
+        int ring = -1;
+        void* sqRing = nullptr;
+        void* cqRing = nullptr;
+        io_uring_sqe* sqes = nullptr;
+        size_t sqRingSize = 0;
+        size_t cqRingSize = 0;
+        size_t sqesSize = 0;
+        unsigned* sqTail = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned sqMask = 0;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned cqMask = 0;
+        io_uring_cqe* cqes = nullptr;
+        const char* buffers[uringBufferCount] = {};
+        size_t pending[uringBufferCount] = {};
+        uint64_t pendingOffset[uringBufferCount] = {};
+        unsigned inFlight = 0;
+        bool failed = false;
+    };
+    static IoUring uring;
+    static std::vector<std::vector<char>> uringBuffers;
+#endif
+    static char* mmapWindow;
+    static char* mmapNextWindow;
+    static size_t mmapWindowSize;
+    static uint64_t mmapWindowOffset;
+    static uint64_t mmapLength;
+    static size_t fileBufferCapacity;
+    static size_t fileBufferUsed;
+    static unsigned int timestampPrecision;
+    // Read by every logging call without the mutex
+    static std::atomic<unsigned int> fileFormat;
+    static unsigned int openFileFormat;
+
+    // Binary log file layout: the creation date line, binaryMagic, the timestamp precision byte, the start time
+    // (8 bytes little endian), a zero padding byte and then format entries and records, each starting with their tag
+    // Format: tag, varint id, varint length, format string
+    // Record: tag, level, varint timestamp delta in ns, varint format id, varint argument count, arguments
+    // Argument: type, then a size byte and a (zigzag) varint for integers, 8 bytes for doubles, a varint for pointers
+    // and a varint length followed by the bytes for strings
+    static constexpr char binaryMagic[] = "PLATYBIN1\n";
+    enum {
+        BINARY_FORMAT = 'F',
+        BINARY_RECORD = 'R'
+    };
+    // Flight recorder file: FlightHeader padded to flightHeaderSize, then recordCount slots of flightRecordSize bytes
+    // Slot: FlightRecord, varint format length, format string, arguments the way EncodeArgs writes them
+    static constexpr char flightMagic[] = "PLATYFR1";
+    static constexpr size_t flightHeaderSize = 64;
+    static constexpr size_t flightRecordSize = 256;
+    static constexpr unsigned int flightLevelShift = 8;
+    struct FlightHeader
+    {
+        char magic[8];
+        uint32_t recordSize;
+        uint32_t recordCount;
+        uint32_t precision;
+        uint32_t reserved;
+        std::atomic<uint64_t> next;
+    };
+    struct FlightRecord
+    {
+        std::atomic<uint64_t> sequence; // Number of the record + 1 once it's complete
+        uint64_t timestamp;
+        uint16_t length;
+        uint8_t logLevel;
+    };
+    static std::atomic<FlightHeader*> flightRecorder;
+    static std::atomic<unsigned int> flightRecorderLevels;
+
+    // Lets the decoders read a block of memory as a stream
+    struct MemoryBuffer : std::streambuf
+    {
+        MemoryBuffer(const char* data, size_t size)
+        {
+            char* begin = const_cast<char*>(data);
+            setg(begin, begin, begin + size);
+        }
+    };
+
+    static std::unordered_map<const char*, uint64_t> binaryFormatIds;
+    static std::vector<std::string> binaryFormats;
+    static uint64_t lastBinaryTimestamp;
+    static unsigned int flushPolicy;
+    static size_t flushBytes;
+    static std::chrono::milliseconds flushInterval;
+    static std::chrono::steady_clock::time_point lastFileFlush;
+
+    static std::atomic<unsigned int> logLevelsToDisplay;
+    static std::atomic<unsigned int> logLevelsToSave;
+    // Levels that go to at least one of the outputs, checked before anything else is done for a message
+    static std::atomic<unsigned int> enabledLevels;
+
+    // Part of an output line
+    struct Segment
+    {
+        const char* data;
+        size_t length;
+    };
+
+    // A single log message waiting to be written
+    struct LogRecord
+    {
+        int logLevel;
+        const char* logLevelStr;
+        unsigned int color;
+        uint64_t timestamp; // Nanoseconds since the epoch
+        // Set when the message holds the raw arguments and still has to be formatted by the writer
+        const char* format;
+        unsigned int argCount;
+        // Set if message has a copy of the format at formatOffset because the caller's one can't be relied on
+        // format is then only used to look the format up, never read
+        bool formatCopied;
+        unsigned int formatOffset;
+        alignas(8) char message[1000];
+    };
+
+    // Slot of the bounded multi-producer/single-consumer ring buffer
+    // The sequence number tells producers and the writer whose turn it is to use the slot
+    struct QueueCell
+    {
+        std::atomic<size_t> sequence;
+        // Copy of record.logLevel that producers dropping the oldest record can read while another one rewrites the cell
+        std::atomic<int> logLevel;
+        LogRecord record;
+    };
+
+    static std::unique_ptr<QueueCell[]> queue;
+    static size_t queueMask;
+    alignas(64) static std::atomic<size_t> enqueuePos;
+    alignas(64) static std::atomic<size_t> dequeuePos;
+
+    // Single-producer/single-consumer buffer owned by one logging thread
+    struct ThreadBuffer
+    {
+        std::unique_ptr<LogRecord[]> records;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+        std::atomic<bool> abandoned{false}; // The thread has exited, freed by the writer once empty
+    };
+
+    // Marks the thread's buffer as abandoned when the thread exits
+    // producing is set while the thread writes into its buffer, DisableAsyncLogging waits for it before freeing
+    // the buffers. It's the thread's own, so unlike a shared counter it never makes logging threads contend
+    struct ThreadBufferOwner
+    {
+        ThreadBuffer* buffer = nullptr;
+        uint64_t generation = 0;
+        std::atomic<bool> producing{false};
+        bool registered = false;
+
+        ~ThreadBufferOwner()
+        {
+            {
+                std::lock_guard<std::mutex> lock(threadBuffersMutex);
+                if(buffer != nullptr && generation == threadBuffersGeneration.load(std::memory_order_relaxed))
+                    buffer->abandoned.store(true, std::memory_order_release);
+            }
+
+            if(registered)
+            {
+                std::lock_guard<std::mutex> lock(threadOwnersMutex);
+                threadOwners.erase(std::find(threadOwners.begin(), threadOwners.end(), this));
+            }
+        }
+    };
+
+    static std::atomic<bool> usePerThreadBuffers;
+    static size_t threadBufferMask;
+    static std::mutex threadBuffersMutex;
+    static std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+    static std::atomic<uint64_t> threadBuffersGeneration;
+    static size_t flushingThreads; // Guarded by threadBuffersMutex
+    // Every thread that got a buffer, only used to wait for them to stop producing
+    static std::mutex threadOwnersMutex;
+    static std::vector<ThreadBufferOwner*> threadOwners;
+    static thread_local ThreadBufferOwner threadBufferOwner;
+
+    static std::thread initThread;
+
+    // Counts the logging calls that are using the queue and the Flush calls waiting on the thread buffers,
+    // DisableAsyncLogging waits for them before freeing either
+    // entered is false if async mode was turned off before the call was counted
+    struct AsyncProducer
+    {
+        bool entered;
+
+        AsyncProducer()
+        {
+            asyncProducers.fetch_add(1, std::memory_order_seq_cst);
+            entered = asyncEnabled.load(std::memory_order_seq_cst);
+        }
+
+        ~AsyncProducer()
+        {
+            asyncProducers.fetch_sub(1, std::memory_order_release);
+        }
+    };
+
+    static std::atomic<bool> asyncEnabled;
+    static std::atomic<size_t> asyncProducers;
+    static std::atomic<bool> writerRunning;
+    static constexpr int levelCount = 6;
+    static std::atomic<unsigned int> overflowPolicies[levelCount];
+    static std::atomic<uint64_t> droppedMessages[levelCount];
+    static std::chrono::steady_clock::time_point lastDropReport;
+    // Set once a crash signal arrived, from then on only the emergency flush writes and the writer thread stops
+    static std::atomic<bool> emergencyFlushing;
+    static std::atomic<bool> writerParked;
+#ifndef PLATY_WINDOWS
+    static constexpr int crashSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    static struct sigaction previousCrashHandlers[sizeof(crashSignals) / sizeof(crashSignals[0])];
+    static int emergencyFile;
+    static uint64_t emergencyFormats;
+    static std::atomic<long> utcOffset;
+
+    // Alternate signal stack of a thread, freed when the thread exits
+    struct CrashStack
+    {
+        char* memory = nullptr;
+        bool checked = false;
+
+        ~CrashStack()
+        {
+            if(memory == nullptr)
+                return;
+
+            stack_t stack{};
+            stack.ss_flags = SS_DISABLE;
+            sigaltstack(&stack, nullptr);
+            delete[] memory;
+        }
+    };
+
+    static constexpr size_t crashStackSize = 64 * 1024;
+    static std::atomic<bool> crashHandlerInstalled;
+    static thread_local CrashStack crashStack;
+#endif
+    static std::atomic<bool> deferredFormatting;
+    // State of the duplicate suppression, guarded by mutex
+    static bool suppressDuplicates;
+    static uint64_t lastRecordHash;
+    static int lastRecordLevel;
+    static const char* lastRecordLevelStr;
+    static unsigned int lastRecordColor;
+    static uint64_t repeatedRecords;
+    static uint64_t repeatsSince;
+    static uint64_t lastRepeatTimestamp;
+    static std::thread writerThread;
+
+    // Drains the queue on destruction so nothing is lost when the program exits
+    struct ShutdownGuard
+    {
+        ~ShutdownGuard()
+        {
+            if(initThread.joinable())
+                initThread.join();
+
+            DisableAsyncLogging();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ReportRepeatedRecords();
+                FlushFileBuffer();
+                CloseLogFile();
+            }
+
+            StopCompression();
+        }
+    };
+    static ShutdownGuard shutdownGuard;
+
+public:
+
+    /// Logging methods
+    template<typename... Args>
+    [[maybe_unused]] static void Trace(const char* message, Args&&... format)
+    {
+        if constexpr(IsLevelCompiled(LOGLEVEL_TRACE))
+            Log(LOGLEVEL_TRACE, "Trace", traceColor, message, std::forward<Args>(format)...);
+    }
+
+    template<typename... Args>
+    [[maybe_unused]] static void Info(const char* message, Args&&... format)
+    {
+        if constexpr(IsLevelCompiled(LOGLEVEL_INFO))
+            Log(LOGLEVEL_INFO, "Info", infoColor, message, std::forward<Args>(format)...);
+    }
+
+    template<typename... Args>
+    [[maybe_unused]] static void Debug(const char* message, Args&&... format)
+    {
+        if constexpr(IsLevelCompiled(LOGLEVEL_DEBUG))
+            Log(LOGLEVEL_DEBUG, "Debug", debugColor, message, std::forward<Args>(format)...);
+    }
+
+    template<typename... Args>
+    [[maybe_unused]] static void Warning(const char* message, Args&&... format)
+    {
+        if constexpr(IsLevelCompiled(LOGLEVEL_WARNING))
+            Log(LOGLEVEL_WARNING, "Warning", warnColor, message, std::forward<Args>(format)...);
+    }
+
+    template<typename... Args>
+    [[maybe_unused]] static void Error(const char* message, Args&&... format)
+    {
+        if constexpr(IsLevelCompiled(LOGLEVEL_ERROR))
+            Log(LOGLEVEL_ERROR, "Error", errorColor, message, std::forward<Args>(format)...);
+    }
+
+    template<typename... Args>
+    [[maybe_unused]] static void Fatal(const char* message, Args&&... format)
+    {
+        // The process is likely about to go down, so it doesn't return before the message is on the disk
+        if constexpr(IsLevelCompiled(LOGLEVEL_FATAL))
+        {
+            Log(LOGLEVEL_FATAL, "Fatal", fatalColor, message, std::forward<Args>(format)...);
+            Flush();
+        }
+    }
+
+public:
+    /// Formatting
+    // Fixed size output of the formatter, anything that doesn't fit is cut off
+    struct FormatBuffer
+    {
+        char* data;
+        size_t capacity;
+        size_t size = 0;
+
+        FormatBuffer(char* buffer, size_t bufferSize) : data(buffer), capacity(bufferSize > 0 ? bufferSize - 1 : 0) {}
+
+        void Append(const char* text, size_t length)
+        {
+            if(length > capacity - size)
+                length = capacity - size;
+            memcpy(data + size, text, length);
+            size += length;
+        }
+
+        void Append(char c)
+        {
+            if(size < capacity)
+                data[size++] = c;
+        }
+
+        void Fill(char c, size_t count)
+        {
+            if(count > capacity - size)
+                count = capacity - size;
+            memset(data + size, c, count);
+            size += count;
+        }
+
+        // Null terminates the output, the terminator always fits
+        void Terminate()
+        {
+            data[size] = '\0';
+        }
+    };
+
+private:
+    // Type erased format argument, the conversion is picked from its real type so a wrong specifier can't read garbage
+    struct FormatArg
+    {
+        enum Type : unsigned char
+        {
+            INT,
+            UINT,
+            CHAR,
+            DOUBLE,
+            STRING,
+            POINTER,
+            CUSTOM,
+            CSTRING // Null terminated, only measured once the specifier is known so %p prints the address
+        };
+
+        Type type;
+        unsigned char size; // Size of the integer after promotion, used to print negative numbers with %u/%x like printf does
+        union
+        {
+            int64_t i;
+            uint64_t u;
+            double d;
+            const void* p;
+            struct
+            {
+                const char* data;
+                size_t length;
+            } s;
+            struct
+            {
+                const void* object;
+                void (*format)(FormatBuffer&, const void*);
+            } custom;
+        };
+    };
+
+    // User types are formatted by a PlatyFormat(Logger::FormatBuffer&, const T&) function found through ADL
+    template<typename T, typename = void>
+    struct HasPlatyFormat : std::false_type {};
+
+    template<typename T>
+    struct HasPlatyFormat<T, std::void_t<decltype(PlatyFormat(std::declval<FormatBuffer&>(), std::declval<const T&>()))>> : std::true_type {};
+
+    template<typename T>
+    static void FormatCustom(FormatBuffer& out, const void* object)
+    {
+        PlatyFormat(out, *(const T*)object);
+    }
+
+    // Parsed printf conversion specification
+    struct FormatSpec
+    {
+        bool leftAlign = false;
+        bool zeroPad = false;
+        bool plusSign = false;
+        bool spaceSign = false;
+        bool alternate = false;
+        int width = 0;
+        int precision = -1;
+        char conversion = 0;
+    };
+
+    template<typename... Args>
+    static constexpr bool hasCStrings = (std::is_convertible_v<std::decay_t<Args>, const char*> || ...);
+
+    template<typename T>
+    static FormatArg MakeFormatArg(const T& value)
+    {
+        using Type = std::decay_t<T>;
+        FormatArg arg;
+
+        if constexpr(std::is_same_v<Type, char>)
+        {
+            arg.type = FormatArg::CHAR;
+            arg.size = sizeof(int);
+            arg.i = value;
+        }
+        else if constexpr(std::is_same_v<Type, bool>)
+        {
+            arg.type = FormatArg::INT;
+            arg.size = sizeof(int);
+            arg.i = value ? 1 : 0;
+        }
+        else if constexpr(std::is_enum_v<Type>)
+        {
+            return MakeFormatArg((std::underlying_type_t<Type>)value);
+        }
+        else if constexpr(std::is_integral_v<Type> && std::is_signed_v<Type>)
+        {
+            arg.type = FormatArg::INT;
+            arg.size = (unsigned char)std::max(sizeof(Type), sizeof(int));
+            arg.i = (int64_t)value;
+        }
+        else if constexpr(std::is_integral_v<Type>)
+        {
+            arg.type = FormatArg::UINT;
+            arg.size = (unsigned char)std::max(sizeof(Type), sizeof(int));
+            arg.u = (uint64_t)value;
+        }
+        else if constexpr(std::is_floating_point_v<Type>)
+        {
+            arg.type = FormatArg::DOUBLE;
+            arg.size = sizeof(double);
+            arg.d = (double)value;
+        }
+        else if constexpr(std::is_convertible_v<Type, const char*>)
+        {
+            // Arrays are never read past their end, even without a terminator
+            arg.type = FormatArg::CSTRING;
+            arg.size = 0;
+            arg.s.data = value;
+            arg.s.length = std::is_array_v<T> ? std::extent_v<T> : SIZE_MAX;
+        }
+        else if constexpr(std::is_convertible_v<const Type&, std::string_view>)
+        {
+            // std::string, std::string_view and friends are referenced, not copied
+            std::string_view text = value;
+            arg.type = FormatArg::STRING;
+            arg.size = 0;
+            arg.s.data = text.data();
+            arg.s.length = text.size();
+        }
+        else if constexpr(HasPlatyFormat<Type>::value)
+        {
+            arg.type = FormatArg::CUSTOM;
+            arg.size = 0;
+            arg.custom.object = &value;
+            arg.custom.format = FormatCustom<Type>;
+        }
+        else if constexpr(std::is_pointer_v<Type> || std::is_null_pointer_v<Type>)
+        {
+            arg.type = FormatArg::POINTER;
+            arg.size = sizeof(void*);
+            arg.p = (const void*)value;
+        }
+        else
+        {
+            static_assert(sizeof(Type) == 0, "Unsupported type passed to a logging function, declare a PlatyFormat(Logger::FormatBuffer&, const T&) for it");
+        }
+
+        return arg;
+    }
+
+    // printf compatible formatter, writes the message straight into the output without any allocation
+    // Missing arguments leave their specifier in the output, extra arguments are ignored
+    static void FormatMessage(FormatBuffer& out, const char* format, const FormatArg* args, size_t argCount)
+    {
+        size_t nextArg = 0;
+        const char* literal = format;
+
+        while(*format != '\0')
+        {
+            if(*format != '%')
+            {
+                format++;
+                continue;
+            }
+
+            out.Append(literal, (size_t)(format - literal));
+            const char* specStart = format++;
+
+            if(*format == '%')
+            {
+                out.Append('%');
+                literal = ++format;
+                continue;
+            }
+
+            FormatSpec spec;
+            ParseSpec(format, spec, args, argCount, nextArg);
+            if(spec.conversion == '\0')
+            {
+                literal = specStart;
+                break;
+            }
+            format++;
+            literal = format;
+
+            if(spec.conversion == 'n')
+                continue;
+
+            if(nextArg >= argCount)
+            {
+                out.Append(specStart, (size_t)(format - specStart));
+                continue;
+            }
+
+            FormatValue(out, spec, args[nextArg++]);
+        }
+
+        out.Append(literal, (size_t)(format - literal));
+    }
+
+    // Reads the flags, width, precision and length of the specification at format, which is left on the conversion
+    // A * width or precision takes the next argument
+    static void ParseSpec(const char*& format, FormatSpec& spec, const FormatArg* args, size_t argCount, size_t& nextArg)
+    {
+        for(;; format++)
+        {
+            if(*format == '-') spec.leftAlign = true;
+            else if(*format == '0') spec.zeroPad = true;
+            else if(*format == '+') spec.plusSign = true;
+            else if(*format == ' ') spec.spaceSign = true;
+            else if(*format == '#') spec.alternate = true;
+            else break;
+        }
+
+        if(*format == '*')
+        {
+            format++;
+            if(nextArg < argCount)
+            {
+                spec.width = (int)args[nextArg++].i;
+                if(spec.width < 0)
+                {
+                    spec.leftAlign = true;
+                    spec.width = -spec.width;
+                }
+            }
+        }
+        else
+        {
+            while(*format >= '0' && *format <= '9')
+                spec.width = spec.width * 10 + (*format++ - '0');
+        }
+
+        if(*format == '.')
+        {
+            format++;
+            spec.precision = 0;
+            if(*format == '*')
+            {
+                format++;
+                if(nextArg < argCount)
+                    spec.precision = std::max((int)args[nextArg++].i, -1);
+            }
+            else
+            {
+                while(*format >= '0' && *format <= '9')
+                    spec.precision = spec.precision * 10 + (*format++ - '0');
+            }
+        }
+
+        // Length modifiers don't matter, the argument type is already known
+        while(*format == 'h' || *format == 'l' || *format == 'L' || *format == 'q' || *format == 'j' || *format == 'z' || *format == 't')
+            format++;
+
+        spec.conversion = *format;
+    }
+
+    // Turns a CSTRING into the POINTER %p prints or the STRING every other conversion prints, reading no more than the precision
+    static void MeasureCString(FormatArg& arg, const FormatSpec& spec)
+    {
+        if(arg.type != FormatArg::CSTRING)
+            return;
+
+        const char* text = arg.s.data;
+        if(spec.conversion == 'p')
+        {
+            arg.type = FormatArg::POINTER;
+            arg.size = sizeof(void*);
+            arg.p = text;
+            return;
+        }
+
+        size_t maxLength = arg.s.length;
+        if(spec.precision >= 0)
+            maxLength = std::min(maxLength, (size_t)spec.precision);
+        if(text == nullptr)
+            text = "(null)";
+        arg.type = FormatArg::STRING;
+        arg.s.data = text;
+        arg.s.length = strnlen(text, maxLength);
+    }
+
+    // Measures the CSTRING arguments against their specifiers before the arguments are copied out of the call
+    // The ones without a specifier are never printed and become empty strings
+    static void MeasureCStrings(const char* format, FormatArg* args, size_t argCount)
+    {
+        size_t nextArg = 0;
+        while(*format != '\0' && nextArg < argCount)
+        {
+            if(*format++ != '%')
+                continue;
+            if(*format == '%')
+            {
+                format++;
+                continue;
+            }
+
+            FormatSpec spec;
+            ParseSpec(format, spec, args, argCount, nextArg);
+            if(spec.conversion == '\0')
+                break;
+            format++;
+            if(spec.conversion != 'n' && nextArg < argCount)
+                MeasureCString(args[nextArg++], spec);
+        }
+
+        for(size_t i = 0; i < argCount; i++)
+        {
+            if(args[i].type == FormatArg::CSTRING)
+            {
+                args[i].type = FormatArg::STRING;
+                args[i].s.length = 0;
+            }
+        }
+    }
+
+    static void FormatValue(FormatBuffer& out, FormatSpec& spec, const FormatArg& arg)
+    {
+        char c = spec.conversion;
+        bool integerConversion = c == 'd' || c == 'i' || c == 'u' || c == 'x' || c == 'X' || c == 'o';
+        bool floatConversion = c == 'f' || c == 'F' || c == 'e' || c == 'E' || c == 'g' || c == 'G' || c == 'a' || c == 'A';
+
+        switch(arg.type)
+        {
+            case FormatArg::CHAR:
+                if(c == 'c' || c == 's')
+                {
+                    char value = (char)arg.i;
+                    FormatPadded(out, spec, "", 0, &value, 1);
+                    return;
+                }
+                [[fallthrough]];
+            case FormatArg::INT:
+            case FormatArg::UINT:
+                if(floatConversion)
+                {
+                    FormatDouble(out, spec, arg.type == FormatArg::UINT ? (double)arg.u : (double)arg.i);
+                }
+                else if(c == 'c')
+                {
+                    char value = (char)arg.i;
+                    FormatPadded(out, spec, "", 0, &value, 1);
+                }
+                else
+                {
+                    if(!integerConversion)
+                        spec.conversion = arg.type == FormatArg::UINT ? 'u' : 'd';
+                    FormatInteger(out, spec, arg);
+                }
+                return;
+            case FormatArg::DOUBLE:
+                if(!floatConversion)
+                {
+                    spec.conversion = 'g';
+                    if(integerConversion)
+                        spec.precision = -1;
+                }
+                FormatDouble(out, spec, arg.d);
+                return;
+            case FormatArg::STRING:
+            {
+                size_t length = arg.s.length;
+                if(spec.precision >= 0 && (size_t)spec.precision < length)
+                    length = (size_t)spec.precision;
+                spec.zeroPad = false;
+                FormatPadded(out, spec, "", 0, arg.s.data, length);
+                return;
+            }
+            case FormatArg::CSTRING:
+            {
+                FormatArg measured = arg;
+                MeasureCString(measured, spec);
+                FormatValue(out, spec, measured);
+                return;
+            }
+            case FormatArg::POINTER:
+            {
+                if(arg.p == nullptr)
+                {
+                    spec.zeroPad = false;
+                    FormatPadded(out, spec, "", 0, "(nil)", 5);
+                    return;
+                }
+                char digits[24];
+                char* end = std::to_chars(digits, digits + sizeof(digits), (uint64_t)(uintptr_t)arg.p, 16).ptr;
+                FormatPadded(out, spec, "0x", 2, digits, (size_t)(end - digits));
+                return;
+            }
+            case FormatArg::CUSTOM:
+            {
+                if(spec.width == 0 && spec.precision < 0)
+                {
+                    arg.custom.format(out, arg.custom.object);
+                    return;
+                }
+
+                // Goes through a temporary buffer to know the length for the padding
+                char text[256];
+                FormatBuffer textBuffer(text, sizeof(text));
+                arg.custom.format(textBuffer, arg.custom.object);
+                size_t length = textBuffer.size;
+                if(spec.precision >= 0 && (size_t)spec.precision < length)
+                    length = (size_t)spec.precision;
+                spec.zeroPad = false;
+                FormatPadded(out, spec, "", 0, text, length);
+                return;
+            }
+        }
+    }
+
+    static void FormatInteger(FormatBuffer& out, const FormatSpec& spec, const FormatArg& arg)
+    {
+        char c = spec.conversion;
+        bool isSigned = c == 'd' || c == 'i';
+        int base = (c == 'x' || c == 'X') ? 16 : c == 'o' ? 8 : 10;
+
+        // Reinterprets the value at its promoted width, the same way printf would
+        uint64_t mask = arg.size >= 8 ? UINT64_MAX : (((uint64_t)1 << (arg.size * 8)) - 1);
+        uint64_t magnitude;
+        bool negative = false;
+        if(isSigned)
+        {
+            int64_t value = arg.type == FormatArg::UINT ? (int64_t)arg.u : arg.i;
+            negative = value < 0;
+            magnitude = negative ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+        }
+        else
+        {
+            magnitude = arg.type == FormatArg::UINT ? arg.u : ((uint64_t)arg.i & mask);
+        }
+
+        char digits[72];
+        char* digitsEnd = digits;
+        if(!(magnitude == 0 && spec.precision == 0))
+            digitsEnd = std::to_chars(digits, digits + sizeof(digits), magnitude, base).ptr;
+        size_t digitCount = (size_t)(digitsEnd - digits);
+
+        if(c == 'X')
+        {
+            for(char* digit = digits; digit < digitsEnd; digit++)
+                *digit = (char)toupper(*digit);
+        }
+
+        char prefix[4];
+        size_t prefixLength = 0;
+        if(negative)
+            prefix[prefixLength++] = '-';
+        else if(isSigned && spec.plusSign)
+            prefix[prefixLength++] = '+';
+        else if(isSigned && spec.spaceSign)
+            prefix[prefixLength++] = ' ';
+
+        if(spec.alternate && magnitude != 0 && base == 16)
+        {
+            prefix[prefixLength++] = '0';
+            prefix[prefixLength++] = c;
+        }
+        else if(spec.alternate && base == 8 && (digitCount == 0 || digits[0] != '0'))
+        {
+            prefix[prefixLength++] = '0';
+        }
+
+        // A precision is the minimum number of digits
+        if(spec.precision >= 0 && (size_t)spec.precision > digitCount)
+        {
+            size_t zeros = std::min((size_t)spec.precision - digitCount, sizeof(digits) - digitCount);
+            memmove(digits + zeros, digits, digitCount);
+            memset(digits, '0', zeros);
+            digitCount += zeros;
+        }
+
+        FormatSpec padSpec = spec;
+        if(spec.precision >= 0)
+            padSpec.zeroPad = false;
+        FormatPadded(out, padSpec, prefix, prefixLength, digits, digitCount);
+    }
+
+    static void FormatDouble(FormatBuffer& out, const FormatSpec& spec, double value)
+    {
+        char c = spec.conversion;
+        bool upper = c == 'F' || c == 'E' || c == 'G' || c == 'A';
+        int precision = spec.precision < 0 ? 6 : std::min(spec.precision, 64);
+
+        char prefix[4];
+        size_t prefixLength = 0;
+        if(std::signbit(value))
+        {
+            prefix[prefixLength++] = '-';
+            value = -value;
+        }
+        else if(spec.plusSign)
+        {
+            prefix[prefixLength++] = '+';
+        }
+        else if(spec.spaceSign)
+        {
+            prefix[prefixLength++] = ' ';
+        }
+
+        if((c == 'a' || c == 'A') && std::isfinite(value))
+        {
+            prefix[prefixLength++] = '0';
+            prefix[prefixLength++] = 'x';
+        }
+
+        char digits[400];
+        std::to_chars_result result;
+        switch(c)
+        {
+            case 'e':
+            case 'E':
+                result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::scientific, precision);
+                break;
+            case 'g':
+            case 'G':
+                result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, precision == 0 ? 1 : precision);
+                break;
+            case 'a':
+            case 'A':
+                result = spec.precision < 0 ? std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::hex)
+                                            : std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::hex, precision);
+                break;
+            default:
+                result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed, precision);
+                break;
+        }
+
+        // Only huge fixed point numbers don't fit
+        if(result.ec != std::errc())
+            result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::scientific, precision);
+
+        size_t digitCount = (size_t)(result.ptr - digits);
+        if(upper)
+        {
+            for(size_t i = 0; i < prefixLength; i++)
+                prefix[i] = (char)toupper(prefix[i]);
+            for(size_t i = 0; i < digitCount; i++)
+                digits[i] = (char)toupper(digits[i]);
+        }
+
+        FormatSpec padSpec = spec;
+        if(!std::isfinite(value))
+            padSpec.zeroPad = false;
+        FormatPadded(out, padSpec, prefix, prefixLength, digits, digitCount);
+    }
+
+    // Writes prefix and body padded to the width of the specification
+    static void FormatPadded(FormatBuffer& out, const FormatSpec& spec, const char* prefix, size_t prefixLength, const char* body, size_t bodyLength)
+    {
+        size_t length = prefixLength + bodyLength;
+        size_t padding = spec.width > 0 && (size_t)spec.width > length ? (size_t)spec.width - length : 0;
+
+        if(spec.leftAlign)
+        {
+            out.Append(prefix, prefixLength);
+            out.Append(body, bodyLength);
+            out.Fill(' ', padding);
+        }
+        else if(spec.zeroPad)
+        {
+            out.Append(prefix, prefixLength);
+            out.Fill('0', padding);
+            out.Append(body, bodyLength);
+        }
+        else
+        {
+            out.Fill(' ', padding);
+            out.Append(prefix, prefixLength);
+            out.Append(body, bodyLength);
+        }
+    }
+
+    /// Helper functions
+    template<typename... Args>
+    static void Log(const int logLevel, const char* logLevelStr, unsigned int color, const char* message, Args&&... format)
+    {
+        // The flight recorder's levels are above the output levels, one load covers both
+        unsigned int levels = enabledLevels.load(std::memory_order_relaxed);
+        if((levels & (logLevel | logLevel << flightLevelShift)) == 0)
+            return;
+
+#ifndef PLATY_WINDOWS
+        if(crashHandlerInstalled.load(std::memory_order_relaxed))
+            SetUpCrashStack();
+#endif
+
+        // Read once, the clock costs more than the rest of the flight recorder
+        uint64_t timestamp = GetTimestamp();
+        if((levels & logLevel << flightLevelShift) != 0)
+        {
+            FormatArg args[sizeof...(Args) + 1] = {MakeFormatArg(format)...};
+            if constexpr(hasCStrings<Args...>)
+                MeasureCStrings(message, args, sizeof...(Args));
+            RecordFlight(logLevel, timestamp, message, args, sizeof...(Args));
+        }
+        if((levels & logLevel) == 0)
+            return;
+
+        if(asyncEnabled.load(std::memory_order_relaxed))
+        {
+            // Only deferred formatting promises literal formats, the binary file alone has to copy them for the writer thread
+            bool deferred = deferredFormatting.load(std::memory_order_relaxed);
+            bool copyFormat = !deferred && fileFormat.load(std::memory_order_relaxed) == FILEFORMAT_BINARY;
+            ThreadBufferOwner& owner = threadBufferOwner;
+            ThreadBuffer* buffer = usePerThreadBuffers.load(std::memory_order_relaxed) ? EnterThreadBuffer(owner) : nullptr;
+            if(buffer != nullptr)
+            {
+                // Never touched by other producers, only waits if the writer is behind on this thread
+                size_t head = buffer->head.load(std::memory_order_relaxed);
+                if(head - buffer->tail.load(std::memory_order_acquire) > threadBufferMask)
+                {
+                    if(overflowPolicies[LevelIndex(logLevel)].load(std::memory_order_relaxed) != OVERFLOW_BLOCK)
+                    {
+                        droppedMessages[LevelIndex(logLevel)].fetch_add(1, std::memory_order_relaxed);
+                        owner.producing.store(false, std::memory_order_release);
+                        return;
+                    }
+                    while(head - buffer->tail.load(std::memory_order_acquire) > threadBufferMask)
+                        std::this_thread::yield();
+                }
+
+                FillRecord(buffer->records[head & threadBufferMask], deferred, copyFormat, timestamp, logLevel, logLevelStr, color, message, std::forward<Args>(format)...);
+                buffer->head.store(head + 1, std::memory_order_release);
+                owner.producing.store(false, std::memory_order_release);
+                return;
+            }
+
+            AsyncProducer producer;
+            if(producer.entered && !usePerThreadBuffers.load(std::memory_order_relaxed))
+            {
+                // Only the record is filled in here, the writer thread does the actual output
+                size_t pos = 0;
+                QueueCell* cell = ClaimQueueCell(pos, logLevel);
+                if(cell == nullptr)
+                    return;
+                FillRecord(cell->record, deferred, copyFormat, timestamp, logLevel, logLevelStr, color, message, std::forward<Args>(format)...);
+                cell->logLevel.store(logLevel, std::memory_order_relaxed);
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return;
+            }
+        }
+
+        LogRecord record;
+        // The binary file stores the raw arguments
+        FillRecord(record, fileFormat.load(std::memory_order_relaxed) == FILEFORMAT_BINARY, false, timestamp, logLevel, logLevelStr, color, message, std::forward<Args>(format)...);
+
+        mutex.lock();
+        WriteRecord(record);
+        mutex.unlock();
+    }
+
+    template<typename... Args>
+    static void FillRecord(LogRecord& record, bool deferred, bool copyFormat, uint64_t timestamp, const int logLevel, const char* logLevelStr, unsigned int color, const char* message, Args&&... format)
+    {
+        record.logLevel = logLevel;
+        record.logLevelStr = logLevelStr;
+        record.color = color;
+        record.timestamp = timestamp;
+
+        FormatArg args[sizeof...(Args) + 1] = {MakeFormatArg(format)...};
+        if constexpr(hasCStrings<Args...>)
+        {
+            if(deferred || copyFormat)
+                MeasureCStrings(message, args, sizeof...(Args));
+        }
+        if((deferred || copyFormat) && StoreArgs(record, args, sizeof...(Args), copyFormat ? message : nullptr))
+        {
+            record.format = message;
+            return;
+        }
+
+        record.format = nullptr;
+        FormatBuffer buffer(record.message, sizeof(record.message));
+        FormatMessage(buffer, message, args, sizeof...(Args));
+        buffer.Terminate();
+    }
+
+    // Copies the arguments into the record so they can be formatted later, strings are copied after the argument array
+    // and after them copyFormat if it's set. Returns false if they don't fit or can't outlive the call (user types)
+    static bool StoreArgs(LogRecord& record, const FormatArg* args, size_t argCount, const char* copyFormat)
+    {
+        size_t offset = argCount * sizeof(FormatArg);
+        if(offset > sizeof(record.message))
+            return false;
+
+        FormatArg* storedArgs = (FormatArg*)record.message;
+        for(size_t i = 0; i < argCount; i++)
+        {
+            storedArgs[i] = args[i];
+            if(args[i].type == FormatArg::CUSTOM)
+                return false;
+
+            if(args[i].type == FormatArg::STRING)
+            {
+                if(args[i].s.length > sizeof(record.message) - offset)
+                    return false;
+                memcpy(record.message + offset, args[i].s.data, args[i].s.length);
+                storedArgs[i].s.data = (const char*)(uintptr_t)offset;
+                offset += args[i].s.length;
+            }
+        }
+
+        record.formatCopied = false;
+        if(copyFormat != nullptr)
+        {
+            size_t length = strlen(copyFormat) + 1;
+            if(length > sizeof(record.message) - offset)
+                return false;
+            memcpy(record.message + offset, copyFormat, length);
+            record.formatOffset = (unsigned int)offset;
+            record.formatCopied = true;
+        }
+
+        record.argCount = (unsigned int)argCount;
+        return true;
+    }
+
+    // Writes the message into the next slot of the flight recorder, the format is copied since the process may be gone when it's read
+    // The sequence is cleared first and set last, so a slot that was cut off by a crash is recognized
+    static void RecordFlight(int logLevel, uint64_t timestamp, const char* format, const FormatArg* args, size_t argCount)
+    {
+        FlightHeader* recorder = flightRecorder.load(std::memory_order_acquire);
+        if(recorder == nullptr)
+            return;
+
+        uint64_t number = recorder->next.fetch_add(1, std::memory_order_relaxed);
+        char* slot = (char*)recorder + flightHeaderSize + (number & (recorder->recordCount - 1)) * flightRecordSize;
+        FlightRecord* record = (FlightRecord*)slot;
+        record->sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        // Leaves room for the argument count
+        char* out = slot + sizeof(FlightRecord);
+        char* end = slot + flightRecordSize;
+        size_t formatLength = std::min(strlen(format), (size_t)(end - out) - 3);
+        WriteVarint(out, formatLength);
+        CopyShort(out, format, formatLength);
+        out = EncodeArgs(out + formatLength, end, args, argCount, 0);
+
+        record->timestamp = timestamp;
+        record->length = (uint16_t)(out - slot - sizeof(FlightRecord));
+        record->logLevel = (uint8_t)logLevel;
+        record->sequence.store(number + 1, std::memory_order_release);
+    }
+
+    // The format of a record made with deferred formatting, the copy if it has one
+    static const char* RecordFormat(const LogRecord& record)
+    {
+        return record.formatCopied ? record.message + record.formatOffset : record.format;
+    }
+
+    // Formats a record made with deferred formatting into text
+    static size_t FormatStoredArgs(const LogRecord& record, char* text, size_t textSize)
+    {
+        FormatArg args[sizeof(record.message) / sizeof(FormatArg)];
+        memcpy(args, record.message, record.argCount * sizeof(FormatArg));
+        for(unsigned int i = 0; i < record.argCount; i++)
+        {
+            if(args[i].type == FormatArg::STRING)
+                args[i].s.data = record.message + (uintptr_t)args[i].s.data;
+        }
+
+        FormatBuffer buffer(text, textSize);
+        FormatMessage(buffer, RecordFormat(record), args, record.argCount);
+        buffer.Terminate();
+        return buffer.size;
+    }
+
+    static void WriteRecord(const LogRecord& record)
+    {
+        if(suppressDuplicates && SuppressDuplicate(record))
+            return;
+        OutputRecord(record);
+    }
+
+    // Counts the record instead of writing it if it's the same as the last one written
+    static bool SuppressDuplicate(const LogRecord& record)
+    {
+        uint64_t hash = HashRecord(record);
+        if(hash == lastRecordHash && record.logLevel == lastRecordLevel)
+        {
+            // Records from different threads can come slightly out of order
+            repeatedRecords++;
+            lastRepeatTimestamp = std::max(lastRepeatTimestamp, record.timestamp);
+            // Long runs still show up once a second
+            if(lastRepeatTimestamp >= repeatsSince + 1000000000)
+                ReportRepeatedRecords();
+            return true;
+        }
+
+        ReportRepeatedRecords();
+        lastRecordHash = hash;
+        lastRecordLevel = record.logLevel;
+        lastRecordLevelStr = record.logLevelStr;
+        lastRecordColor = record.color;
+        repeatsSince = record.timestamp;
+        lastRepeatTimestamp = record.timestamp;
+        return false;
+    }
+
+    // Writes how often the last record was repeated since it or the previous report was written
+    static void ReportRepeatedRecords()
+    {
+        if(repeatedRecords == 0)
+            return;
+
+        LogRecord record;
+        FillRecord(record, false, false, lastRepeatTimestamp, lastRecordLevel, lastRecordLevelStr, lastRecordColor, "Last message repeated %llu times over %.3f s",
+                   (unsigned long long)repeatedRecords, (double)(lastRepeatTimestamp - repeatsSince) / 1e9);
+        repeatedRecords = 0;
+        repeatsSince = lastRepeatTimestamp;
+        OutputRecord(record);
+    }
+
+    // FNV-1a over the text, or over the format and the argument values of a deferred record
+    // Argument padding isn't initialized, so the values are hashed one by one
+    static uint64_t HashRecord(const LogRecord& record)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const void* data, size_t length)
+        {
+            for(size_t i = 0; i < length; i++)
+                hash = (hash ^ ((const unsigned char*)data)[i]) * 1099511628211ull;
+        };
+
+        if(record.format == nullptr)
+        {
+            mix(record.message, strlen(record.message));
+            return hash;
+        }
+
+        // A copied format can come from a buffer that is reused for other formats
+        uintptr_t format = (uintptr_t)record.format;
+        if(record.formatCopied)
+            mix(RecordFormat(record), strlen(RecordFormat(record)));
+        else
+            mix(&format, sizeof(format));
+        const FormatArg* args = (const FormatArg*)record.message;
+        for(unsigned int i = 0; i < record.argCount; i++)
+        {
+            mix(&args[i].type, sizeof(args[i].type));
+            if(args[i].type == FormatArg::STRING)
+            {
+                mix(record.message + (uintptr_t)args[i].s.data, args[i].s.length);
+                continue;
+            }
+
+            uintptr_t pointer = (uintptr_t)args[i].p;
+            if(args[i].type == FormatArg::POINTER)
+                mix(&pointer, sizeof(pointer));
+            else
+                mix(&args[i].u, sizeof(args[i].u));
+        }
+        return hash;
+    }
+
+    static void OutputRecord(const LogRecord& record)
+    {
+        bool display = (logLevelsToDisplay.load(std::memory_order_relaxed) & record.logLevel) != 0;
+        bool save = (logLevelsToSave.load(std::memory_order_relaxed) & record.logLevel) != 0;
+
+        // Both limits are precomputed when the file is opened, off is the maximum value
+        if(save && (fileBytesWritten >= rotateAtBytes || record.timestamp >= rotateAtTime) && IsLogFileOpen()
+           && !emergencyFlushing.load(std::memory_order_relaxed))
+            RotateLogFile();
+
+        bool binary = openFileFormat == FILEFORMAT_BINARY || (shouldCreateNewFile && fileFormat.load(std::memory_order_relaxed) == FILEFORMAT_BINARY);
+
+        // The binary file takes the raw arguments, text only has to be made if something prints it
+        const char* message = record.message;
+        char formatted[sizeof(record.message)];
+        size_t messageLength;
+        if(record.format != nullptr && (display || (save && !binary)))
+        {
+            messageLength = FormatStoredArgs(record, formatted, sizeof(formatted));
+            message = formatted;
+        }
+        else
+        {
+            messageLength = strlen(message);
+        }
+
+        SET_COLOR(console, record.color);
+        char header[48];
+        size_t headerLength = FormatHeader(header, record.timestamp, record.logLevelStr, timestampPrecision);
+
+        // The line is written as its parts, neither output has to join them first
+        Segment line[] = {{header, headerLength}, {" - ", 3}, {message, messageLength}, {"\n", 1}};
+        if(display)
+            WriteToConsole(line, 4);
+
+        if(save && binary)
+            LogToBinaryFile(record, message);
+        else if(save)
+            LogToFile(record.logLevel, line, 4);
+    }
+
+    static void WriteToConsole(const Segment* segments, size_t count)
+    {
+#ifdef PLATY_WINDOWS
+        // The color is set on the console itself, stdio keeps the text in order with it
+        for(size_t i = 0; i < count; i++)
+            fwrite(segments[i].data, 1, segments[i].length, stdout);
+#else
+        // Anything printed through stdio before the line comes first, stdio can't be used from a signal handler though
+        if(!emergencyFlushing.load(std::memory_order_relaxed))
+            fflush(stdout);
+        WriteSegments(STDOUT_FILENO, segments, count, -1);
+#endif
+    }
+
+    static void UpdateEnabledLevels()
+    {
+        unsigned int outputLevels = logLevelsToDisplay.load(std::memory_order_relaxed) | logLevelsToSave.load(std::memory_order_relaxed);
+        enabledLevels.store(outputLevels | flightRecorderLevels.load(std::memory_order_relaxed) << flightLevelShift, std::memory_order_relaxed);
+    }
+
+    // Reserves the next free slot in the queue, if the queue is full it does what the overflow policy of the level says
+    // Returns nullptr if the message is dropped
+    static QueueCell* ClaimQueueCell(size_t& pos, int logLevel)
+    {
+        pos = enqueuePos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            QueueCell* cell = &queue[pos & queueMask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+            if(diff == 0)
+            {
+                if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return cell;
+            }
+            else if(diff < 0)
+            {
+                // Queue is full
+                unsigned int policy = overflowPolicies[LevelIndex(logLevel)].load(std::memory_order_relaxed);
+                if(policy == OVERFLOW_DROP_NEWEST)
+                {
+                    droppedMessages[LevelIndex(logLevel)].fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                if(policy == OVERFLOW_BLOCK || !DropOldestQueued(policy == OVERFLOW_OVERWRITE))
+                    std::this_thread::yield();
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Takes the oldest record out of the queue the same way the writer does, without writing it
+    // Unless anyLevel is set, records of levels that block are left alone
+    static bool DropOldestQueued(bool anyLevel)
+    {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        QueueCell* cell = &queue[pos & queueMask];
+        if(cell->sequence.load(std::memory_order_acquire) != pos + 1)
+            return false;
+
+        // Only used if the cell is still the oldest one after the exchange, so it's the same record
+        int logLevel = cell->logLevel.load(std::memory_order_relaxed);
+        if(!anyLevel && overflowPolicies[LevelIndex(logLevel)].load(std::memory_order_relaxed) == OVERFLOW_BLOCK)
+            return false;
+        if(!dequeuePos.compare_exchange_strong(pos, pos + 1, std::memory_order_relaxed))
+            return false;
+
+        droppedMessages[LevelIndex(logLevel)].fetch_add(1, std::memory_order_relaxed);
+        cell->sequence.store(pos + queueMask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Writes a Warning with the number of messages of each level dropped since the last report, at most once per second
+    static void ReportDroppedMessages(bool now)
+    {
+        bool dropped = false;
+        for(int i = 0; i < levelCount; i++)
+            dropped |= droppedMessages[i].load(std::memory_order_relaxed) != 0;
+        if(!dropped)
+            return;
+
+        auto time = std::chrono::steady_clock::now();
+        if(!now && time - lastDropReport < std::chrono::seconds(1))
+            return;
+        lastDropReport = time;
+
+        for(int i = 0; i < levelCount; i++)
+        {
+            uint64_t count = droppedMessages[i].exchange(0, std::memory_order_relaxed);
+            if(count == 0)
+                continue;
+
+            // Written directly, going through the queue could block on the queue this thread empties
+            LogRecord record;
+            FillRecord(record, false, false, GetTimestamp(), LOGLEVEL_WARNING, "Warning", warnColor, "Log queue was full, dropped %llu %s messages", (unsigned long long)count, LevelName(1 << i));
+            mutex.lock();
+            WriteRecord(record);
+            mutex.unlock();
+        }
+    }
+
+    // Index of a single LOGLEVEL_* flag
+    static int LevelIndex(int logLevel)
+    {
+        int index = 0;
+        while(index < levelCount - 1 && (logLevel >> index) != 1)
+            index++;
+        return index;
+    }
+
+    // Writes out every record that is ready, returns the number of records written
+    static size_t DrainQueue()
+    {
+        size_t written = 0;
+
+        mutex.lock();
+        for(;;)
+        {
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            QueueCell* cell = &queue[pos & queueMask];
+            if(cell->sequence.load(std::memory_order_acquire) != pos + 1 || emergencyFlushing.load(std::memory_order_relaxed))
+                break;
+
+            // Producers can take the oldest record out as well when their overflow policy lets them
+            if(!dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_acq_rel))
+                continue;
+
+            WriteRecord(cell->record);
+            cell->sequence.store(pos + queueMask + 1, std::memory_order_release);
+            written++;
+        }
+        mutex.unlock();
+
+        return written;
+    }
+
+    // Marks the thread as producing and returns its buffer, or nullptr with the mark cleared if async mode is off
+    // No lock may be taken while the mark is set, DisableAsyncLogging holds threadOwnersMutex while waiting for it
+    static ThreadBuffer* EnterThreadBuffer(ThreadBufferOwner& owner)
+    {
+        for(;;)
+        {
+            owner.producing.store(true, std::memory_order_seq_cst);
+            if(!asyncEnabled.load(std::memory_order_seq_cst))
+            {
+                owner.producing.store(false, std::memory_order_release);
+                return nullptr;
+            }
+            if(owner.buffer != nullptr && owner.generation == threadBuffersGeneration.load(std::memory_order_relaxed))
+                return owner.buffer;
+
+            owner.producing.store(false, std::memory_order_release);
+            CreateThreadBuffer(owner);
+        }
+    }
+
+    static void CreateThreadBuffer(ThreadBufferOwner& owner)
+    {
+        if(!owner.registered)
+        {
+            std::lock_guard<std::mutex> lock(threadOwnersMutex);
+            threadOwners.push_back(&owner);
+            owner.registered = true;
+        }
+
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+        buffer->records.reset(new LogRecord[threadBufferMask + 1]);
+
+        std::lock_guard<std::mutex> lock(threadBuffersMutex);
+        owner.buffer = buffer.get();
+        owner.generation = threadBuffersGeneration.load(std::memory_order_relaxed);
+        threadBuffers.push_back(std::move(buffer));
+    }
+
+    // Writes out the records of every thread buffer merged by their timestamps, returns the number of records written
+    static size_t DrainThreadBuffers()
+    {
+        struct Pending
+        {
+            ThreadBuffer* buffer;
+            size_t tail;
+            size_t head;
+        };
+
+        std::vector<Pending> pending;
+        {
+            std::lock_guard<std::mutex> lock(threadBuffersMutex);
+
+            // Frees the buffers of exited threads once they have been written and no Flush is waiting on them
+            if(flushingThreads == 0)
+            {
+                threadBuffers.erase(std::remove_if(threadBuffers.begin(), threadBuffers.end(), [](const std::unique_ptr<ThreadBuffer>& buffer)
+                {
+                    return buffer->abandoned.load(std::memory_order_acquire)
+                           && buffer->tail.load(std::memory_order_relaxed) == buffer->head.load(std::memory_order_acquire);
+                }), threadBuffers.end());
+            }
+
+            for(const auto& buffer : threadBuffers)
+            {
+                size_t tail = buffer->tail.load(std::memory_order_relaxed);
+                size_t head = buffer->head.load(std::memory_order_acquire);
+                if(tail != head)
+                    pending.push_back({buffer.get(), tail, head});
+            }
+        }
+
+        size_t written = 0;
+        mutex.lock();
+        while(!pending.empty() && !emergencyFlushing.load(std::memory_order_relaxed))
+        {
+            size_t oldest = 0;
+            for(size_t i = 1; i < pending.size(); i++)
+            {
+                if(pending[i].buffer->records[pending[i].tail & threadBufferMask].timestamp
+                   < pending[oldest].buffer->records[pending[oldest].tail & threadBufferMask].timestamp)
+                    oldest = i;
+            }
+
+            Pending& next = pending[oldest];
+            WriteRecord(next.buffer->records[next.tail & threadBufferMask]);
+            next.tail++;
+            next.buffer->tail.store(next.tail, std::memory_order_release);
+            written++;
+
+            if(next.tail == next.head)
+            {
+                next = pending.back();
+                pending.pop_back();
+            }
+        }
+        mutex.unlock();
+
+        return written;
+    }
+
+    static size_t DrainAll()
+    {
+        return usePerThreadBuffers.load(std::memory_order_relaxed) ? DrainThreadBuffers() + DrainQueue() : DrainQueue();
+    }
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 2;
+        while(result < value)
+            result <<= 1;
+        return result;
+    }
+
+    static void WriterLoop()
+    {
+#ifndef PLATY_WINDOWS
+        if(crashHandlerInstalled.load(std::memory_order_relaxed))
+            SetUpCrashStack();
+#endif
+
+        unsigned int idleRounds = 0;
+        while(writerRunning.load(std::memory_order_acquire))
+        {
+            // The crash handler takes over, this thread must not touch the queue or the file anymore
+            if(emergencyFlushing.load(std::memory_order_relaxed))
+            {
+                writerParked.store(true, std::memory_order_release);
+                while(true)
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+            }
+
+            size_t written = DrainAll();
+            ReportDroppedMessages(false);
+            if(written > 0)
+            {
+                idleRounds = 0;
+                continue;
+            }
+
+            mutex.lock();
+            if(repeatedRecords > 0 && GetTimestamp() >= repeatsSince + 1000000000)
+                ReportRepeatedRecords();
+            FlushFileIfDue();
+            mutex.unlock();
+
+            // Backs off to sleeping when there is nothing to write
+            if(++idleRounds < 64)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        // Flushes whatever was enqueued before shutdown, producers that already claimed a cell get to finish it
+        while(DrainAll() > 0 || dequeuePos.load(std::memory_order_relaxed) < enqueuePos.load(std::memory_order_acquire))
+            std::this_thread::yield();
+        ReportDroppedMessages(true);
+    }
+
+#ifndef PLATY_WINDOWS
+    // Gives the calling thread an alternate signal stack for the crash handler, unless it already has one
+    static void SetUpCrashStack()
+    {
+        CrashStack& stack = crashStack;
+        if(stack.checked)
+            return;
+        stack.checked = true;
+
+        stack_t current;
+        if(sigaltstack(nullptr, &current) == 0 && (current.ss_flags & SS_DISABLE) == 0)
+            return;
+
+        // SIGSTKSZ isn't a constant on every system
+        size_t size = std::max<size_t>(SIGSTKSZ, crashStackSize);
+        stack_t alternate{};
+        alternate.ss_sp = new char[size];
+        alternate.ss_size = size;
+        if(sigaltstack(&alternate, nullptr) == 0)
+            stack.memory = (char*)alternate.ss_sp;
+        else
+            delete[] (char*)alternate.ss_sp;
+    }
+
+    static void HandleCrashSignal(int signal)
+    {
+        EmergencyFlush();
+
+        // The previous handler gets the signal once this one returns
+        for(size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]); i++)
+        {
+            if(crashSignals[i] == signal)
+                sigaction(signal, &previousCrashHandlers[i], nullptr);
+        }
+        raise(signal);
+    }
+
+    // Writes out every record that was logged, only with what can be used in a signal handler:
+    // no locks, no allocations, no stdio, files are written with write(2)
+    // Locks that are held can't be waited for, so this is best effort if another thread is writing at the same time
+    static void EmergencyFlush()
+    {
+        if(emergencyFlushing.exchange(true))
+            return;
+
+        // Gives the writer thread time to finish the record it's on
+        if(writerRunning.load(std::memory_order_acquire) && writerThread.get_id() != std::this_thread::get_id())
+        {
+            timespec millisecond = {0, 1000000};
+            for(int i = 0; i < 100 && !writerParked.load(std::memory_order_acquire); i++)
+                nanosleep(&millisecond, nullptr);
+        }
+
+        if(openFileSink == FILESINK_STREAM && fs.is_open())
+            emergencyFile = ::open(latestLogFilepath.c_str(), O_WRONLY | O_APPEND);
+
+        if(queue != nullptr)
+        {
+            for(size_t pos = dequeuePos.load(std::memory_order_acquire);; pos++)
+            {
+                QueueCell* cell = &queue[pos & queueMask];
+                if(cell->sequence.load(std::memory_order_acquire) != pos + 1)
+                    break;
+                WriteRecord(cell->record);
+            }
+        }
+
+        // Merged by timestamp like DrainThreadBuffers, without building a list of them first
+        while(usePerThreadBuffers.load(std::memory_order_relaxed))
+        {
+            ThreadBuffer* oldest = nullptr;
+            for(const auto& buffer : threadBuffers)
+            {
+                size_t tail = buffer->tail.load(std::memory_order_relaxed);
+                if(tail == buffer->head.load(std::memory_order_acquire))
+                    continue;
+                if(oldest == nullptr || buffer->records[tail & threadBufferMask].timestamp
+                   < oldest->records[oldest->tail.load(std::memory_order_relaxed) & threadBufferMask].timestamp)
+                    oldest = buffer.get();
+            }
+            if(oldest == nullptr)
+                break;
+
+            size_t tail = oldest->tail.load(std::memory_order_relaxed);
+            WriteRecord(oldest->records[tail & threadBufferMask]);
+            oldest->tail.store(tail + 1, std::memory_order_release);
+        }
+
+        ReportRepeatedRecords();
+        FlushFileBuffer();
+
+        // Whatever the sink still holds goes to the kernel, which keeps it after the process is gone
+        if(openFileSink == FILESINK_MMAP && logFile >= 0 && ftruncate(logFile, (off_t)mmapLength) != 0)
+        {
+            // Readers stop at the preallocated zeros
+        }
+#ifdef PLATY_IO_URING
+        if(openFileSink == FILESINK_URING && uring.ring >= 0)
+            UringWait();
+#endif
+        if(emergencyFile >= 0)
+            ::close(emergencyFile);
+    }
+#endif
+
+    static void InitLogFile()
+    {
+        CreateLoggingDirectories();
+        LoadArchiveIndex();
+        if(logLevelsToSave.load(std::memory_order_relaxed) != LOGLEVEL_NONE)
+            PrepareLogFile();
+    }
+
+    // Creates the logging directories and opens the log file for the first message, returns false if there is no file to write to
+    static bool PrepareLogFile()
+    {
+        // For the first log it saves the latest_log file and creates a new one
+        // The file then stays open until the logger shuts down
+        if(shouldCreateNewFile && !emergencyFlushing.load(std::memory_order_relaxed))
+        {
+            // Created once, after that they are only recreated if writing to them fails
+            if(!loggingDirectoriesCreated)
+                CreateLoggingDirectories();
+
+            if(std::filesystem::exists(latestLogFilepath))
+                SaveLatestLog();
+
+            if(fileBuffer.size() != fileBufferCapacity)
+                fileBuffer.resize(fileBufferCapacity);
+
+            shouldCreateNewFile = false;
+            if(!OpenLogFile(false))
+            {
+                SetLevelsToSave(LOGLEVEL_NONE);
+                return false;
+            }
+            lastFileFlush = std::chrono::steady_clock::now();
+
+            // Both formats start with the creation date, it is used to name the file once it's archived
+            uint64_t now = GetTimestamp();
+            currentFileCreated = (time_t)(now / 1000000000);
+            UpdateRotationLimits();
+
+            tm t = GetTime(currentFileCreated);
+            char creationDate[64];
+            int length = sprintf(creationDate, "Created - %i. %i. %i. %i:%i:%i\n", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+            AppendToFileBuffer(creationDate, length);
+
+            openFileFormat = fileFormat.load(std::memory_order_relaxed);
+            if(openFileFormat == FILEFORMAT_BINARY)
+            {
+                char start[sizeof(binaryMagic) + 9] = {};
+                memcpy(start, binaryMagic, sizeof(binaryMagic) - 1);
+                start[sizeof(binaryMagic) - 1] = (char)timestampPrecision;
+                WriteFixed64(start + sizeof(binaryMagic), now);
+                AppendToFileBuffer(start, sizeof(start));
+
+                binaryFormatIds.clear();
+                binaryFormats.clear();
+                lastBinaryTimestamp = now;
+            }
+            else
+            {
+                AppendToFileBuffer("\n", 1);
+            }
+        }
+
+        return IsLogFileOpen();
+    }
+
+    static void LogToFile(const int logLevel, const Segment* line, size_t count)
+    {
+        if(!PrepareLogFile())
+            return;
+
+        size_t length = 0;
+        for(size_t i = 0; i < count; i++)
+            length += line[i].length;
+
+        // Lines that don't fit into the buffer are written in one go, without being split into a write per part
+        if(openFileSink != FILESINK_MMAP && length > fileBuffer.size())
+        {
+            FlushFileBuffer();
+            WriteToFile(line, count);
+            fileBytesWritten += length;
+        }
+        else
+        {
+            for(size_t i = 0; i < count; i++)
+                AppendToFileBuffer(line[i].data, line[i].length);
+        }
+
+        FlushAfterWrite(logLevel);
+    }
+
+    // Writes the record in the binary format, formats are written to the file once and then referenced by their id
+    static void LogToBinaryFile(const LogRecord& record, const char* message)
+    {
+        if(!PrepareLogFile())
+            return;
+
+        const char* key = record.format != nullptr ? record.format : "%s";
+        uint64_t formatId = GetBinaryFormatId(key, record.format != nullptr ? RecordFormat(record) : key);
+
+        char encoded[2 * sizeof(record.message) + 64];
+        char* out = encoded;
+        *out++ = BINARY_RECORD;
+        *out++ = (char)record.logLevel;
+        WriteVarint(out, record.timestamp - std::min(lastBinaryTimestamp, record.timestamp));
+        WriteVarint(out, formatId);
+        lastBinaryTimestamp = std::max(lastBinaryTimestamp, record.timestamp);
+
+        if(record.format == nullptr)
+        {
+            // Already formatted, stored as a single string argument
+            size_t length = strlen(message);
+            WriteVarint(out, 1);
+            *out++ = FormatArg::STRING;
+            WriteVarint(out, length);
+            memcpy(out, message, length);
+            out += length;
+        }
+        else
+        {
+            out = EncodeArgs(out, encoded + sizeof(encoded), (const FormatArg*)record.message, record.argCount, (uintptr_t)record.message);
+        }
+
+        AppendToFileBuffer(encoded, (size_t)(out - encoded));
+        FlushAfterWrite(record.logLevel);
+    }
+
+    // Reads what EncodeArgs wrote, strings are kept in strings
+    static bool DecodeArgs(std::istream& in, FormatArg* args, uint64_t argCount, std::string& strings)
+    {
+        // Strings are read first and pointed to once they can't move anymore
+        size_t stringOffsets[64];
+        strings.clear();
+        for(uint64_t i = 0; i < argCount; i++)
+        {
+            int type = in.get();
+            uint64_t value = 0;
+            args[i].type = (FormatArg::Type)type;
+            switch(type)
+            {
+                case FormatArg::INT:
+                    args[i].size = (unsigned char)in.get();
+                    if(!ReadVarint(in, value))
+                        return false;
+                    args[i].i = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+                    break;
+                case FormatArg::UINT:
+                case FormatArg::CHAR:
+                    args[i].size = (unsigned char)in.get();
+                    if(!ReadVarint(in, value))
+                        return false;
+                    args[i].u = value;
+                    break;
+                case FormatArg::DOUBLE:
+                    if(!in.read((char*)&args[i].d, sizeof(double)))
+                        return false;
+                    break;
+                case FormatArg::POINTER:
+                    if(!ReadVarint(in, value))
+                        return false;
+                    args[i].p = (const void*)(uintptr_t)value;
+                    break;
+                case FormatArg::STRING:
+                {
+                    if(!ReadVarint(in, value) || value > (1u << 20))
+                        return false;
+                    stringOffsets[i] = strings.size();
+                    strings.resize(strings.size() + value);
+                    if(!in.read(strings.data() + stringOffsets[i], (std::streamsize)value))
+                        return false;
+                    args[i].s.length = value;
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        for(uint64_t i = 0; i < argCount; i++)
+        {
+            if(args[i].type == FormatArg::STRING)
+                args[i].s.data = strings.data() + stringOffsets[i];
+        }
+
+        return true;
+    }
+
+    // memcpy for the few bytes of a format or a string argument, with the length capped the compiler
+    // inlines memcpy as rep movs, which takes longer to start than the whole copy
+    static void CopyShort(char* out, const char* in, size_t length)
+    {
+        size_t copied = 0;
+        for(; copied + 8 <= length; copied += 8)
+            memcpy(out + copied, in + copied, 8);
+        for(; copied < length; copied++)
+            out[copied] = in[copied];
+    }
+
+    // Writes the argument count and the arguments in the binary log layout, strings are at stringBase + s.data
+    // Arguments that don't fit before end are left out, long strings are cut to what fits
+    static char* EncodeArgs(char* out, char* end, const FormatArg* args, size_t argCount, uintptr_t stringBase)
+    {
+        // The count is always a single byte, there are never more than fit into a record
+        char* count = out++;
+        size_t encoded = 0;
+        for(; encoded < argCount; encoded++)
+        {
+            const FormatArg& arg = args[encoded];
+            if(end - out < 12)
+                break;
+
+            *out++ = (char)arg.type;
+            switch(arg.type)
+            {
+                case FormatArg::INT:
+                    *out++ = (char)arg.size;
+                    WriteVarint(out, ((uint64_t)arg.i << 1) ^ (uint64_t)(arg.i >> 63));
+                    break;
+                case FormatArg::UINT:
+                case FormatArg::CHAR:
+                    *out++ = (char)arg.size;
+                    WriteVarint(out, arg.u);
+                    break;
+                case FormatArg::DOUBLE:
+                    memcpy(out, &arg.d, sizeof(double));
+                    out += sizeof(double);
+                    break;
+                case FormatArg::POINTER:
+                    WriteVarint(out, (uint64_t)(uintptr_t)arg.p);
+                    break;
+                case FormatArg::STRING:
+                {
+                    size_t length = std::min(arg.s.length, (size_t)(end - out) - 10);
+                    WriteVarint(out, length);
+                    CopyShort(out, (const char*)(stringBase + (uintptr_t)arg.s.data), length);
+                    out += length;
+                    break;
+                }
+                case FormatArg::CUSTOM:
+                {
+                    // Formatted right away, there is no way to call it back when the record is decoded
+                    out[-1] = FormatArg::STRING;
+                    char* lengthByte = out++;
+                    FormatBuffer buffer(out, std::min((size_t)(end - out), (size_t)127) + 1);
+                    arg.custom.format(buffer, arg.custom.object);
+                    *lengthByte = (char)buffer.size;
+                    out += buffer.size;
+                    break;
+                }
+                case FormatArg::CSTRING:
+                    // MeasureCStrings turns them into strings before they get here
+                    break;
+            }
+        }
+
+        *count = (char)encoded;
+        return out;
+    }
+
+    // key is the address the caller passed the format with, format its text, which differ if the record has a copy
+    static uint64_t GetBinaryFormatId(const char* key, const char* format)
+    {
+        // Looked up by address first, the content is compared as well since a buffer can be reused for another format
+        uint64_t id;
+        size_t length = strlen(format);
+#ifndef PLATY_WINDOWS
+        // Nothing may be allocated in the crash handler, every format gets its own entry there
+        if(emergencyFlushing.load(std::memory_order_relaxed))
+        {
+            id = binaryFormats.size() + emergencyFormats++;
+        }
+        else
+#endif
+        {
+            auto found = binaryFormatIds.find(key);
+            if(found != binaryFormatIds.end() && binaryFormats[found->second] == format)
+                return found->second;
+
+            id = binaryFormats.size();
+            binaryFormats.emplace_back(format, length);
+            binaryFormatIds[key] = id;
+        }
+
+        char entry[32];
+        char* out = entry;
+        *out++ = BINARY_FORMAT;
+        WriteVarint(out, id);
+        WriteVarint(out, length);
+        AppendToFileBuffer(entry, (size_t)(out - entry));
+        AppendToFileBuffer(format, length);
+
+        return id;
+    }
+
+    static bool ReadVarint(std::istream& in, uint64_t& value)
+    {
+        value = 0;
+        for(int shift = 0; shift < 64; shift += 7)
+        {
+            int byte = in.get();
+            if(byte == EOF)
+                return false;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    static void WriteVarint(char*& out, uint64_t value)
+    {
+        while(value >= 0x80)
+        {
+            *out++ = (char)(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = (char)value;
+    }
+
+    static void WriteFixed64(char* out, uint64_t value)
+    {
+        for(int i = 0; i < 8; i++)
+            out[i] = (char)(value >> (i * 8));
+    }
+
+    static void FlushAfterWrite(const int logLevel)
+    {
+        if((flushPolicy & FLUSH_EVERY_LINE) != 0
+           || ((flushPolicy & FLUSH_ON_ERROR) != 0 && logLevel >= LOGLEVEL_ERROR)
+           || ((flushPolicy & FLUSH_EVERY_N_BYTES) != 0 && fileBufferUsed >= flushBytes))
+        {
+            FlushFileBuffer();
+        }
+        else
+        {
+            FlushFileIfDue();
+        }
+    }
+
+    static void AppendToFileBuffer(const char* data, size_t length)
+    {
+        // The mapped file is already memory, buffering it would only add a copy
+        if(openFileSink == FILESINK_MMAP)
+        {
+            WriteToFile(data, length);
+            fileBytesWritten += length;
+            return;
+        }
+
+        if(fileBufferUsed + length > fileBuffer.size())
+        {
+            FlushFileBuffer();
+
+            // Too big to ever fit into the buffer, goes straight to the file
+            if(length > fileBuffer.size())
+            {
+                WriteToFile(data, length);
+                fileBytesWritten += length;
+                return;
+            }
+        }
+
+        memcpy(fileBuffer.data() + fileBufferUsed, data, length);
+        fileBufferUsed += length;
+        fileBytesWritten += length;
+    }
+
+    static void FlushFileBuffer()
+    {
+        // Emptied before the write, a crash handler that runs in between must not write the same lines again
+        size_t used = fileBufferUsed;
+        fileBufferUsed = 0;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        if(used > 0 && IsLogFileOpen())
+            WriteToFile(fileBuffer.data(), used);
+        lastFileFlush = std::chrono::steady_clock::now();
+    }
+
+    static void WriteToFile(const char* data, size_t length)
+    {
+        Segment segment = {data, length};
+        WriteToFile(&segment, 1);
+    }
+
+    static void WriteToFile(const Segment* segments, size_t count)
+    {
+        if(WriteToOpenFile(segments, count) || emergencyFlushing.load(std::memory_order_relaxed))
+            return;
+
+        // The directories or the file may have been deleted, reopens the log and tries once more
+        CloseLogFile();
+        CreateLoggingDirectories();
+        if(OpenLogFile(true) && WriteToOpenFile(segments, count))
+            return;
+
+        CloseLogFile();
+        SetLevelsToSave(LOGLEVEL_NONE);
+    }
+
+    static bool OpenLogFile(bool append)
+    {
+        openFileSink = fileSink;
+#ifndef PLATY_WINDOWS
+        if(openFileSink == FILESINK_MMAP)
+            return MmapOpen(append);
+        if(openFileSink == FILESINK_URING)
+            return UringOpen(append);
+#endif
+        openFileSink = FILESINK_STREAM;
+        fs.clear();
+        fs.rdbuf()->pubsetbuf(nullptr, 0);
+        fs.open(latestLogFilepath, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+        return fs.is_open();
+    }
+
+    static bool IsLogFileOpen()
+    {
+        return openFileSink == FILESINK_STREAM ? fs.is_open() : logFile >= 0;
+    }
+
+    static bool WriteToOpenFile(const Segment* segments, size_t count)
+    {
+#ifndef PLATY_WINDOWS
+        if(openFileSink == FILESINK_MMAP)
+        {
+            for(size_t i = 0; i < count; i++)
+            {
+                if(!MmapWrite(segments[i].data, segments[i].length))
+                    return false;
+            }
+            return true;
+        }
+        if(openFileSink == FILESINK_URING)
+            return UringWrite(segments, count);
+
+        // Goes around the stream, it may be in the middle of a write on another thread
+        if(emergencyFlushing.load(std::memory_order_relaxed))
+            return emergencyFile >= 0 && WriteSegments(emergencyFile, segments, count, -1);
+#endif
+        for(size_t i = 0; i < count; i++)
+            fs.write(segments[i].data, (std::streamsize)segments[i].length);
+        fs.flush();
+        return fs.good();
+    }
+
+    static void CloseLogFile()
+    {
+#ifndef PLATY_WINDOWS
+        if(openFileSink == FILESINK_MMAP)
+        {
+            MmapClose();
+            return;
+        }
+        if(openFileSink == FILESINK_URING)
+        {
+            UringClose();
+            return;
+        }
+#endif
+        fs.clear();
+        fs.close();
+    }
+
+#ifndef PLATY_WINDOWS
+    // The mmap sink keeps two windows of the file mapped, the one being written and the next one,
+    // which is allocated and mapped once the current one is half full so crossing into it is only a pointer swap
+    static bool MmapOpen(bool append)
+    {
+        logFile = ::open(latestLogFilepath.c_str(), O_RDWR | O_CREAT | (append ? 0 : O_TRUNC), 0644);
+        if(logFile < 0)
+            return false;
+
+        struct stat fileStat;
+        mmapLength = (append && fstat(logFile, &fileStat) == 0) ? (uint64_t)fileStat.st_size : 0;
+        mmapWindowOffset = mmapLength - mmapLength % mmapWindowSize;
+        mmapNextWindow = nullptr;
+        mmapWindow = MmapWindow(mmapWindowOffset);
+        if(mmapWindow == nullptr)
+        {
+            ::close(logFile);
+            logFile = -1;
+            return false;
+        }
+
+        return true;
+    }
+
+    // Allocates the disk space for the window and maps it
+    static char* MmapWindow(uint64_t offset)
+    {
+        if(posix_fallocate(logFile, (off_t)offset, (off_t)mmapWindowSize) != 0)
+            return nullptr;
+
+        void* window = mmap(nullptr, mmapWindowSize, PROT_READ | PROT_WRITE, MAP_SHARED, logFile, (off_t)offset);
+        return window == MAP_FAILED ? nullptr : (char*)window;
+    }
+
+    static bool MmapWrite(const char* data, size_t length)
+    {
+        while(length > 0)
+        {
+            if(mmapLength == mmapWindowOffset + mmapWindowSize)
+            {
+                char* next = mmapNextWindow != nullptr ? mmapNextWindow : MmapWindow(mmapWindowOffset + mmapWindowSize);
+                if(next == nullptr)
+                    return false;
+
+                munmap(mmapWindow, mmapWindowSize);
+                mmapWindow = next;
+                mmapNextWindow = nullptr;
+                mmapWindowOffset += mmapWindowSize;
+            }
+
+            size_t windowPosition = (size_t)(mmapLength - mmapWindowOffset);
+            size_t chunk = std::min(length, mmapWindowSize - windowPosition);
+            memcpy(mmapWindow + windowPosition, data, chunk);
+            mmapLength += chunk;
+            data += chunk;
+            length -= chunk;
+        }
+
+        // Prepares the next window ahead of time
+        if(mmapNextWindow == nullptr && mmapLength - mmapWindowOffset >= mmapWindowSize / 2)
+            mmapNextWindow = MmapWindow(mmapWindowOffset + mmapWindowSize);
+
+        return true;
+    }
+
+    // Unmaps the windows and cuts off the space that was allocated but not written
+    static void MmapClose()
+    {
+        if(logFile < 0)
+            return;
+
+        if(mmapWindow != nullptr)
+            munmap(mmapWindow, mmapWindowSize);
+        if(mmapNextWindow != nullptr)
+            munmap(mmapNextWindow, mmapWindowSize);
+        mmapWindow = nullptr;
+        mmapNextWindow = nullptr;
+
+        if(ftruncate(logFile, (off_t)mmapLength) != 0)
+        {
+            // Leaves the preallocated zeros at the end, readers stop at them
+        }
+        ::close(logFile);
+        logFile = -1;
+    }
+
+    // The io_uring sink hands the full file buffer to the kernel and swaps in one that isn't being written,
+    // so the writer only waits when all of them are still in flight
+    // Without io_uring it writes with pwrite
+    static bool UringOpen(bool append)
+    {
+        logFile = ::open(latestLogFilepath.c_str(), O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), 0644);
+        if(logFile < 0)
+            return false;
+
+        struct stat fileStat;
+        fileOffset = (append && fstat(logFile, &fileStat) == 0) ? (uint64_t)fileStat.st_size : 0;
+#ifdef PLATY_IO_URING
+        UringSetup();
+#endif
+        return true;
+    }
+
+    // Writes all of the segments with as few calls as possible, a negative offset writes at the current position
+    static bool WriteSegments(int fd, const Segment* segments, size_t count, int64_t offset)
+    {
+        iovec parts[8];
+        size_t partCount = 0;
+        for(size_t i = 0; i < count && partCount < 8; i++)
+        {
+            if(segments[i].length > 0)
+                parts[partCount++] = {(void*)segments[i].data, segments[i].length};
+        }
+
+        size_t part = 0;
+        while(part < partCount)
+        {
+            ssize_t written = offset < 0 ? writev(fd, parts + part, (int)(partCount - part)) : pwritev(fd, parts + part, (int)(partCount - part), (off_t)offset);
+            if(written < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                return false;
+            }
+            if(offset >= 0)
+                offset += written;
+
+            // A partial write can stop in the middle of a part
+            while(part < partCount && (size_t)written >= parts[part].iov_len)
+            {
+                written -= (ssize_t)parts[part].iov_len;
+                part++;
+            }
+            if(part < partCount)
+            {
+                parts[part].iov_base = (char*)parts[part].iov_base + written;
+                parts[part].iov_len -= (size_t)written;
+            }
+        }
+
+        return true;
+    }
+
+    static bool UringWrite(const Segment* segments, size_t count)
+    {
+#ifdef PLATY_IO_URING
+        if(uring.ring >= 0)
+        {
+            if(uring.failed)
+                return false;
+
+            int buffer = count == 1 && !emergencyFlushing.load(std::memory_order_relaxed) ? UringBufferIndex(segments[0].data) : -1;
+            if(buffer >= 0 && segments[0].data == fileBuffer.data())
+                return UringSubmit(buffer, segments[0].length);
+
+            // The data isn't in a registered buffer and may be gone once this returns, so it's written in place
+            if(!UringWait())
+                return false;
+        }
+#endif
+        if(!WriteSegments(logFile, segments, count, (int64_t)fileOffset))
+            return false;
+        for(size_t i = 0; i < count; i++)
+            fileOffset += segments[i].length;
+
+        return (flushPolicy & FLUSH_DURABLE) == 0 || fdatasync(logFile) == 0;
+    }
+
+    static void UringClose()
+    {
+        if(logFile < 0)
+            return;
+
+#ifdef PLATY_IO_URING
+        if(uring.ring >= 0)
+        {
+            UringWait();
+            UringTeardown();
+        }
+#endif
+        ::close(logFile);
+        logFile = -1;
+    }
+
+#ifdef PLATY_IO_URING
+    static void UringSetup()
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int ring = (int)syscall(__NR_io_uring_setup, uringEntries, &params);
+        if(ring < 0)
+            return;
+
+        uring.ring = ring;
+        uring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        uring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        uring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if(singleMap)
+            uring.sqRingSize = uring.cqRingSize = std::max(uring.sqRingSize, uring.cqRingSize);
+
+        uring.sqRing = mmap(nullptr, uring.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        uring.cqRing = singleMap ? uring.sqRing : mmap(nullptr, uring.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+        void* sqes = mmap(nullptr, uring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+        uring.sqes = sqes == MAP_FAILED ? nullptr : (io_uring_sqe*)sqes;
+        if(uring.sqRing == MAP_FAILED || uring.cqRing == MAP_FAILED || uring.sqes == nullptr)
+        {
+            UringTeardown();
+            return;
+        }
+
+        char* sq = (char*)uring.sqRing;
+        char* cq = (char*)uring.cqRing;
+        uring.sqTail = (unsigned*)(sq + params.sq_off.tail);
+        uring.sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+        uring.sqArray = (unsigned*)(sq + params.sq_off.array);
+        uring.cqHead = (unsigned*)(cq + params.cq_off.head);
+        uring.cqTail = (unsigned*)(cq + params.cq_off.tail);
+        uring.cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+        uring.cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
 
-    // Levels to display int he console
-    [[maybe_unused]]static void SetLevelsToDisplay(unsigned int logLevels)
+        // The file buffer and its spares are registered so the kernel doesn't pin their pages for every write
+        uringBuffers.assign(uringBufferCount - 1, std::vector<char>(fileBuffer.size()));
+        iovec buffers[uringBufferCount];
+        buffers[0] = {fileBuffer.data(), fileBuffer.size()};
+        for(size_t i = 1; i < uringBufferCount; i++)
+            buffers[i] = {uringBuffers[i - 1].data(), uringBuffers[i - 1].size()};
+
+        if(syscall(__NR_io_uring_register, ring, IORING_REGISTER_BUFFERS, buffers, uringBufferCount) < 0)
+        {
+            UringTeardown();
+            return;
+        }
+
+        for(size_t i = 0; i < uringBufferCount; i++)
+        {
+            uring.buffers[i] = (const char*)buffers[i].iov_base;
+            uring.pending[i] = 0;
+        }
+        uring.inFlight = 0;
+        uring.failed = false;
+    }
+
+    static void UringTeardown()
     {
-        logLevelsToDisplay = logLevels;
+        if(uring.sqes != nullptr)
+            munmap(uring.sqes, uring.sqesSize);
+        if(uring.cqRing != nullptr && uring.cqRing != MAP_FAILED && uring.cqRing != uring.sqRing)
+            munmap(uring.cqRing, uring.cqRingSize);
+        if(uring.sqRing != nullptr && uring.sqRing != MAP_FAILED)
+            munmap(uring.sqRing, uring.sqRingSize);
+        ::close(uring.ring);
+        uring = IoUring();
+        uringBuffers.clear();
     }
 
-    // Levels to save into log files
-    [[maybe_unused]]static void SetLevelsToSave(unsigned int logLevels)
+    static int UringBufferIndex(const char* data)
     {
-        logLevelsToSave = logLevels;
+        for(size_t i = 0; i < uringBufferCount; i++)
+        {
+            if(uring.buffers[i] == data)
+                return (int)i;
+        }
+
+        return -1;
     }
 
-    [[maybe_unused]]static void SetNumberOfFilesToSave(unsigned int numberToSave)
+    static io_uring_sqe* UringNextEntry(unsigned& tail)
     {
-        pastLogsToKeep = numberToSave;
+        unsigned index = tail++ & uring.sqMask;
+        uring.sqArray[index] = index;
+        memset(&uring.sqes[index], 0, sizeof(io_uring_sqe));
+        return &uring.sqes[index];
     }
 
-private:
-    static void* console;
-    static const unsigned int traceColor;
-    static const unsigned int infoColor;
-    static const unsigned int debugColor;
-    static const unsigned int warnColor;
-    static const unsigned int errorColor;
-    static const unsigned int fatalColor;
+    static bool UringSubmit(int buffer, size_t length)
+    {
+        unsigned tail = *uring.sqTail;
+        io_uring_sqe* write = UringNextEntry(tail);
+        write->opcode = IORING_OP_WRITE_FIXED;
+        write->fd = logFile;
+        write->off = fileOffset;
+        write->addr = (uint64_t)(uintptr_t)uring.buffers[buffer];
+        write->len = (uint32_t)length;
+        write->buf_index = (uint16_t)buffer;
+        write->user_data = (uint64_t)buffer;
 
-    static const std::string latestLogFilepath;
-    static const std::string pastLogsFilepath;
-    static const std::string logsFilepath;
-    static bool shouldCreateNewFile;
-    static unsigned int pastLogsToKeep;
+        // Linked, so it only starts once the write is done
+        if((flushPolicy & FLUSH_DURABLE) != 0)
+        {
+            write->flags |= IOSQE_IO_LINK;
+            io_uring_sqe* sync = UringNextEntry(tail);
+            sync->opcode = IORING_OP_FSYNC;
+            sync->fd = logFile;
+            sync->fsync_flags = IORING_FSYNC_DATASYNC;
+            sync->user_data = UINT64_MAX;
+        }
 
-    static std::mutex mutex;
-    static std::fstream fs;
+        unsigned submitted = tail - *uring.sqTail;
+        __atomic_store_n(uring.sqTail, tail, __ATOMIC_RELEASE);
+        uring.pending[buffer] = length;
+        uring.pendingOffset[buffer] = fileOffset;
+        uring.inFlight += submitted;
+        fileOffset += length;
 
-    static unsigned int logLevelsToDisplay;
-    static unsigned int logLevelsToSave;
+        while(syscall(__NR_io_uring_enter, uring.ring, submitted, 0, 0, nullptr, 0) < 0)
+        {
+            if(errno != EINTR && errno != EAGAIN)
+                return false;
+        }
 
-public:
+        // Logging carries on in a buffer the kernel is done with
+        while(true)
+        {
+            UringReap();
+            for(std::vector<char>& spare : uringBuffers)
+            {
+                int index = UringBufferIndex(spare.data());
+                if(index < 0 || uring.pending[index] == 0)
+                {
+                    std::swap(fileBuffer, spare);
+                    return true;
+                }
+            }
 
-    /// Logging methods
-    template<typename... Args>
-    [[maybe_unused]] static void Trace(const char* message, Args... format)
+            if(!UringAwaitCompletion())
+                return false;
+        }
+    }
+
+    static bool UringAwaitCompletion()
+    {
+        if(syscall(__NR_io_uring_enter, uring.ring, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+        {
+            uring.failed = true;
+            return false;
+        }
+
+        return true;
+    }
+
+    static void UringReap()
     {
-        Log(LOGLEVEL_TRACE, "Trace", traceColor, message, format...);
+        unsigned head = *uring.cqHead;
+        while(head != __atomic_load_n(uring.cqTail, __ATOMIC_ACQUIRE))
+        {
+            const io_uring_cqe& completion = uring.cqes[head & uring.cqMask];
+            if(completion.user_data < uringBufferCount)
+            {
+                size_t buffer = (size_t)completion.user_data;
+                if(completion.res < 0)
+                {
+                    uring.failed = true;
+                }
+                else if((size_t)completion.res < uring.pending[buffer])
+                {
+                    // Short write, the rest goes through pwrite
+                    size_t done = (size_t)completion.res;
+                    Segment rest = {uring.buffers[buffer] + done, uring.pending[buffer] - done};
+                    if(!WriteSegments(logFile, &rest, 1, (int64_t)(uring.pendingOffset[buffer] + done)))
+                        uring.failed = true;
+                }
+                uring.pending[buffer] = 0;
+            }
+            else if(completion.res < 0 && completion.res != -ECANCELED)
+            {
+                uring.failed = true;
+            }
+
+            uring.inFlight--;
+            head++;
+        }
+
+        __atomic_store_n(uring.cqHead, head, __ATOMIC_RELEASE);
     }
 
-    template<typename... Args>
-    [[maybe_unused]] static void Info(const char* message, Args... format)
+    // Waits for everything that was submitted
+    static bool UringWait()
     {
-        Log(LOGLEVEL_INFO, "Info", infoColor, message, format...);
+        UringReap();
+        while(uring.inFlight > 0)
+        {
+            if(!UringAwaitCompletion())
+                return false;
+            UringReap();
+        }
+
+        return !uring.failed;
     }
+#endif
+#endif
 
-    template<typename... Args>
-    [[maybe_unused]] static void Debug(const char* message, Args... format)
+    // Flushes the buffer if the flush interval has passed since the last flush
+    static void FlushFileIfDue()
     {
-        Log(LOGLEVEL_DEBUG, "Debug", debugColor, message, format...);
+        if((flushPolicy & FLUSH_INTERVAL) != 0 && fileBufferUsed > 0
+           && std::chrono::steady_clock::now() - lastFileFlush >= flushInterval)
+        {
+            FlushFileBuffer();
+        }
     }
 
-    template<typename... Args>
-    [[maybe_unused]] static void Warning(const char* message, Args... format)
+    static void SaveLatestLog()
     {
-        Log(LOGLEVEL_WARNING, "Warning", warnColor, message, format...);
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(latestLogFilepath, error);
+        PruneArchives(error ? 0 : size);
+        ArchiveLog(ReadCreationTime(latestLogFilepath), error ? 0 : size);
     }
 
-    template<typename... Args>
-    [[maybe_unused]] static void Error(const char* message, Args... format)
+    // Makes room for an archive of incomingBytes, everything is decided from the index without reading the directory
+    static void PruneArchives(uint64_t incomingBytes)
+    {
+        LoadArchiveIndex();
+
+        // If the past_logs folder is full it deletes the oldest logs
+        while(!archiveIndex.empty() && archiveIndex.size() >= pastLogsToKeep)
+            RemoveOldestArchive("Maximum number of past logs reached");
+
+        while(!archiveIndex.empty() && archiveBytes + incomingBytes > retentionBytes)
+            RemoveOldestArchive("Maximum size of past logs reached");
+
+        if(retentionAge.count() > 0)
+        {
+            time_t oldestAllowed = std::time(nullptr) - (time_t)retentionAge.count();
+            while(!archiveIndex.empty() && archiveIndex.begin()->created < oldestAllowed)
+                RemoveOldestArchive("Past log is too old");
+        }
+
+        if(minimumFreeSpace > 0)
+        {
+            // One statvfs, the space freed by removing archives is known from their tracked sizes
+            std::error_code error;
+            std::filesystem::space_info space = std::filesystem::space(pastLogsFilepath, error);
+            if(!error)
+            {
+                uint64_t available = space.available;
+                while(!archiveIndex.empty() && available < minimumFreeSpace)
+                {
+                    available += archiveIndex.begin()->size;
+                    RemoveOldestArchive("Not enough free disk space");
+                }
+            }
+        }
+    }
+
+    static void RemoveOldestArchive(const char* reason)
     {
-        Log(LOGLEVEL_ERROR, "Error", errorColor, message, format...);
+        auto oldest = archiveIndex.begin();
+        SET_COLOR(console, errorColor);
+        printf("%s, removing: %s\n", reason, oldest->path.c_str());
+
+        std::error_code error;
+        std::filesystem::remove(oldest->path, error);
+        archiveBytes -= std::min(archiveBytes, oldest->size);
+        archiveIndex.erase(oldest);
     }
 
-    template<typename... Args>
-    [[maybe_unused]] static void Fatal(const char* message, Args... format)
+    // Reads past_logs once, after that the index is kept up to date by ArchiveLog and PruneArchives
+    static void LoadArchiveIndex()
     {
-        Log(LOGLEVEL_FATAL, "Fatal", fatalColor, message, format...);
+        if(archiveIndexLoaded)
+            return;
+        archiveIndexLoaded = true;
+
+        std::error_code error;
+        for(const auto& entry : std::filesystem::directory_iterator(pastLogsFilepath, error))
+        {
+            if(!entry.is_regular_file(error))
+                continue;
+
+            // Leftover of a compression that was interrupted
+            if(entry.path().extension() == ".tmp")
+            {
+                std::filesystem::remove(entry.path(), error);
+                continue;
+            }
+
+            // The compressed copy was finished but the original not removed yet
+            bool uncompressed = entry.path().extension() == ".txt";
+            if(uncompressed && std::filesystem::exists(entry.path().string() + ".plz", error))
+            {
+                std::filesystem::remove(entry.path(), error);
+                continue;
+            }
 
+            ArchivedLog archive;
+            archive.path = entry.path().string();
+            if(!ParseArchiveName(entry.path().filename().string(), archive.created, archive.suffix))
+            {
+                // Not named by the logger, sorted by its last modification instead
+                archive.created = ReadCreationTime(archive.path);
+                archive.suffix = 0;
+            }
+            archive.size = entry.file_size(error);
+            if(error)
+                archive.size = 0;
+            archiveBytes += archive.size;
+            archiveIndex.insert(archive);
+
+            // Compression that was still waiting or running when the last run ended is picked up again
+            if(uncompressed && archiveCompression)
+                QueueCompression(archive);
+        }
     }
 
-private:
-    /// Helper functions
-    template<typename... Args>
-    static void Log(const int logLevel, const char* logLevelStr, unsigned int color, const char* message, Args... format)
+    // Gets the creation time and the same second suffix out of a name made by ArchiveLog
+    static bool ParseArchiveName(const std::string& filename, time_t& created, int& suffix)
     {
-        mutex.lock();
+        tm t{};
+        int length = 0;
+        if(sscanf(filename.c_str(), "log_%d.%d.%d.%d-%d-%d%n", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec, &length) != 6)
+            return false;
 
-        SET_COLOR(console, color);
-        char header[32], messageBuffer[1000];
-        sprintf(header, "[%i:%i:%i] <%s>", GetTime()->tm_hour, GetTime()->tm_min, GetTime()->tm_sec, logLevelStr);
-        sprintf(messageBuffer, message, format...);
+        suffix = 0;
+        if(filename[length] == '_')
+            sscanf(filename.c_str() + length, "_%d", &suffix);
 
-        if((logLevelsToDisplay & logLevel) != 0)
-            printf("%s - %s\n", header, messageBuffer);
+        t.tm_year -= 1900;
+        t.tm_mon -= 1;
+        t.tm_isdst = -1;
+        created = std::mktime(&t);
+        return created != -1;
+    }
 
-        if((logLevelsToSave & logLevel) != 0)
-            LogToFile(header, messageBuffer);
+    // Archives the current log and starts a new one with the next message
+    // The creation time is already known so the file isn't read again
+    static void RotateLogFile()
+    {
+        FlushFileBuffer();
+        CloseLogFile();
 
-        mutex.unlock();
+        PruneArchives(fileBytesWritten);
+        ArchiveLog(currentFileCreated, fileBytesWritten);
+        shouldCreateNewFile = true;
+        rotateAtBytes = UINT64_MAX;
+        rotateAtTime = UINT64_MAX;
+    }
+
+    // Sets the limits for the file that was just created
+    static void UpdateRotationLimits()
+    {
+        fileBytesWritten = 0;
+        rotateAtBytes = rotationSize > 0 ? rotationSize : UINT64_MAX;
+        rotateAtTime = UINT64_MAX;
+
+        if(rotationInterval != ROTATE_NONE)
+        {
+            // Next full hour or midnight in local time
+            tm t = GetTime(currentFileCreated);
+            t.tm_min = 0;
+            t.tm_sec = 0;
+            if(rotationInterval == ROTATE_DAILY)
+            {
+                t.tm_hour = 0;
+                t.tm_mday++;
+            }
+            else
+            {
+                t.tm_hour++;
+            }
+            t.tm_isdst = -1;
+            rotateAtTime = (uint64_t)std::mktime(&t) * 1000000000;
+        }
     }
 
-    static void LogToFile(const char* header, const char* message)
+    // Moves latest_log.txt into past_logs, named after its creation time
+    // A rename only touches the directory entries so it costs the same no matter how big the log is
+    static void ArchiveLog(time_t created, uint64_t size)
     {
-        //Creating directories for the logs
-        if(!std::filesystem::exists(logsFilepath) || !std::filesystem::exists(pastLogsFilepath))
+        tm t = GetTime(created);
+        char newFilename[64];
+        sprintf(newFilename, "log_%04i.%02i.%02i.%02i-%02i-%02i", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+
+        // Logs created in the same second get a number after the newest one, so they keep their order
+        LoadArchiveIndex();
+        ArchivedLog archive;
+        archive.created = created;
+        archive.suffix = 0;
+        for(auto found = archiveIndex.lower_bound(archive); found != archiveIndex.end() && found->created == created; ++found)
+            archive.suffix = found->suffix + 1;
+
+        std::string newFileLocation = pastLogsFilepath + newFilename + (archive.suffix > 0 ? "_" + std::to_string(archive.suffix) : "") + ".txt";
+
+        std::error_code error;
+        std::filesystem::rename(latestLogFilepath, newFileLocation, error);
+        if(error)
         {
             CreateLoggingDirectories();
+            std::filesystem::rename(latestLogFilepath, newFileLocation, error);
+        }
+        if(error)
+        {
+            // Renaming can fail if something else has the file open, copying is slower but still works
+            std::filesystem::copy(latestLogFilepath, newFileLocation, std::filesystem::copy_options::overwrite_existing, error);
+            std::filesystem::remove(latestLogFilepath, error);
         }
 
-        // For the first log it saves the latest_log file and creates a new one
-        if(shouldCreateNewFile)
+        archive.path = newFileLocation;
+        archive.size = size;
+        archiveBytes += size;
+        archiveIndex.insert(archive);
+
+        if(archiveCompression)
+            QueueCompression(archive);
+    }
+
+    /// Archive compression
+    // Compressed archive layout: compressedMagic, then blocks of a 4 byte raw size and a 4 byte stored size (little
+    // endian) followed by the data, a raw size of 0 ends the file. Blocks with the top bit of the stored size set are
+    // stored uncompressed, the others are LZ4 style sequences
+    static constexpr char compressedMagic[] = "PLZ1";
+    static constexpr size_t compressionBlockSize = 1 << 22;
+    static constexpr uint32_t storedRawFlag = 0x80000000u;
+
+    static void QueueCompression(const ArchivedLog& archive)
+    {
+        std::lock_guard<std::mutex> lock(compressionMutex);
+        if(!compressionThread.joinable())
         {
-            if(std::filesystem::exists(latestLogFilepath))
-                SaveLatestLog();
+            compressionRunning = true;
+            compressionThread = std::thread(CompressionLoop);
+        }
+        compressionJobs.push_back(archive);
+        compressionCondition.notify_one();
+    }
 
-            fs.open(latestLogFilepath, std::ios::out);
-            shouldCreateNewFile = false;
+    static void StopCompression()
+    {
+        {
+            std::lock_guard<std::mutex> lock(compressionMutex);
+            compressionRunning = false;
+            compressionCondition.notify_one();
+        }
+        if(compressionThread.joinable())
+            compressionThread.join();
+    }
+
+    // Archives that are still waiting when the logger shuts down are left uncompressed, the next run queues them again
+    static void CompressionLoop()
+    {
+        std::unique_lock<std::mutex> lock(compressionMutex);
+        for(;;)
+        {
+            compressionCondition.wait(lock, [] { return !compressionRunning || !compressionJobs.empty(); });
+            if(!compressionRunning)
+                return;
+
+            ArchivedLog archive = compressionJobs.front();
+            compressionJobs.pop_front();
+
+            lock.unlock();
+            CompressArchive(archive);
+            lock.lock();
+        }
+    }
+
+    static void CompressArchive(const ArchivedLog& archive)
+    {
+        std::string compressedPath = archive.path + ".plz";
+        std::string temporaryPath = compressedPath + ".tmp";
+        std::error_code error;
+        uint64_t compressedSize = 0;
 
-            tm* t = GetTime();
-            char creationDate[64];
-            sprintf(creationDate, "Created - %i. %i. %i. %i:%i:%i\n\n", t->tm_year + 1900, t->tm_mon + 1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec);
-            fs << creationDate;
-         }
-        else
         {
-            fs.open(latestLogFilepath, std::ios::app);
+            std::ifstream in(archive.path, std::ios::binary);
+            std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+            if(!in.is_open() || !out.is_open())
+            {
+                std::filesystem::remove(temporaryPath, error);
+                return;
+            }
+
+            std::unique_ptr<unsigned char[]> raw(new unsigned char[compressionBlockSize]);
+            std::unique_ptr<unsigned char[]> compressed(new unsigned char[compressionBlockSize]);
+            out.write(compressedMagic, sizeof(compressedMagic) - 1);
+            compressedSize += sizeof(compressedMagic) - 1;
+
+            for(;;)
+            {
+                in.read((char*)raw.get(), compressionBlockSize);
+                uint32_t rawSize = (uint32_t)in.gcount();
+                if(rawSize == 0)
+                    break;
+
+                // Gives up between blocks if the logger is shutting down
+                if(!compressionRunning)
+                {
+                    out.close();
+                    std::filesystem::remove(temporaryPath, error);
+                    return;
+                }
+
+                uint32_t storedSize = (uint32_t)CompressBlock(raw.get(), rawSize, compressed.get(), rawSize);
+                const unsigned char* stored = compressed.get();
+                if(storedSize == 0)
+                {
+                    storedSize = rawSize | storedRawFlag;
+                    stored = raw.get();
+                }
+
+                char sizes[8];
+                WriteFixed32(sizes, rawSize);
+                WriteFixed32(sizes + 4, storedSize);
+                out.write(sizes, sizeof(sizes));
+                out.write((const char*)stored, storedSize & ~storedRawFlag);
+                compressedSize += sizeof(sizes) + (storedSize & ~storedRawFlag);
+            }
+
+            char end[8] = {};
+            out.write(end, sizeof(end));
+            compressedSize += sizeof(end);
+            if(!out.good())
+            {
+                out.close();
+                std::filesystem::remove(temporaryPath, error);
+                return;
+            }
         }
 
-        // Writes the log
-        if(fs.is_open())
+        std::filesystem::rename(temporaryPath, compressedPath, error);
+        if(error)
         {
-            fs << header << " - " << message << "\n";
+            std::filesystem::remove(temporaryPath, error);
+            return;
         }
-        else
+
+        // Swaps the archive for the compressed one, unless retention removed it in the meantime
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = archiveIndex.find(archive);
+        if(found == archiveIndex.end())
         {
-            SetLevelsToSave(LOGLEVEL_NONE);
-            fs.close();
+            std::filesystem::remove(compressedPath, error);
             return;
         }
 
-        fs.close();
+        ArchivedLog compressedArchive = *found;
+        compressedArchive.path = compressedPath;
+        compressedArchive.size = compressedSize;
+        archiveBytes = archiveBytes - std::min(archiveBytes, found->size) + compressedSize;
+        archiveIndex.erase(found);
+        archiveIndex.insert(compressedArchive);
+        std::filesystem::remove(archive.path, error);
     }
 
-    static void SaveLatestLog()
+    // Greedy LZ4 style compression of one block, returns 0 if the result wouldn't fit into dstCapacity
+    static size_t CompressBlock(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstCapacity)
     {
-        // Creates the logging directories if they are missing
-        if(!std::filesystem::exists(latestLogFilepath))
+        const size_t minMatch = 4;
+        const size_t lastLiterals = 5; // The end of a block is always literals
+        const size_t matchFindLimit = 12;
+        const int hashBits = 14;
+
+        std::unique_ptr<uint32_t[]> table(new uint32_t[(size_t)1 << hashBits]());
+        unsigned char* out = dst;
+        unsigned char* outEnd = dst + dstCapacity;
+        size_t anchor = 0;
+        size_t pos = 0;
+
+        if(srcSize > matchFindLimit)
         {
-            CreateLoggingDirectories();
+            size_t matchLimit = srcSize - lastLiterals;
+            unsigned int misses = 0;
+            while(pos + matchFindLimit < srcSize)
+            {
+                uint32_t sequence;
+                memcpy(&sequence, src + pos, sizeof(sequence));
+                uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+                size_t candidate = table[hash];
+                table[hash] = (uint32_t)pos;
+
+                uint32_t candidateSequence;
+                memcpy(&candidateSequence, src + candidate, sizeof(candidateSequence));
+                if(candidate >= pos || pos - candidate > 65535 || candidateSequence != sequence)
+                {
+                    // Skips ahead faster through data that doesn't compress
+                    pos += 1 + (misses++ >> 6);
+                    continue;
+                }
+                misses = 0;
+
+                size_t matchLength = minMatch;
+                while(pos + matchLength < matchLimit && src[candidate + matchLength] == src[pos + matchLength])
+                    matchLength++;
+
+                if(!WriteSequence(out, outEnd, src + anchor, pos - anchor, pos - candidate, matchLength))
+                    return 0;
+
+                pos += matchLength;
+                anchor = pos;
+            }
         }
 
-        // If the past_logs folder is full it deletes the oldest log
-        if(CountFiles(pastLogsFilepath.c_str()) >= pastLogsToKeep)
+        if(!WriteSequence(out, outEnd, src + anchor, srcSize - anchor, 0, 0))
+            return 0;
+
+        return (size_t)(out - dst);
+    }
+
+    // Writes a token, the literals and the match, a match length of 0 writes only literals
+    static bool WriteSequence(unsigned char*& out, unsigned char* outEnd, const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength)
+    {
+        size_t needed = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+        if(needed > (size_t)(outEnd - out))
+            return false;
+
+        size_t matchCode = matchLength > 0 ? matchLength - 4 : 0;
+        *out++ = (unsigned char)((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15));
+        WriteLengthBytes(out, literalLength);
+        memcpy(out, literals, literalLength);
+        out += literalLength;
+
+        if(matchLength > 0)
         {
-            std::filesystem::path fileToRemove = GetOldestLog();
-            SET_COLOR(console, errorColor);
-            printf("Maximum number of past logs reached, removing: %s\n", fileToRemove.string().c_str());
-            std::filesystem::remove(fileToRemove);
+            *out++ = (unsigned char)(offset & 0xff);
+            *out++ = (unsigned char)(offset >> 8);
+            WriteLengthBytes(out, matchCode);
         }
 
-        // Saves the first line of the log to format its new name
-        std::string newFilename;
-        fs.open(latestLogFilepath);
-        if(fs.is_open())
+        return true;
+    }
+
+    // Lengths of 15 and more continue in extra bytes
+    static void WriteLengthBytes(unsigned char*& out, size_t length)
+    {
+        if(length < 15)
+            return;
+        length -= 15;
+        while(length >= 255)
         {
-            std::getline(fs, newFilename);
+            *out++ = 255;
+            length -= 255;
         }
-        else
+        *out++ = (unsigned char)length;
+    }
+
+    // Returns the size of the decompressed block or 0 if the block is corrupt
+    static size_t DecompressBlock(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstCapacity)
+    {
+        const unsigned char* in = src;
+        const unsigned char* inEnd = src + srcSize;
+        unsigned char* out = dst;
+        unsigned char* outEnd = dst + dstCapacity;
+
+        while(in < inEnd)
         {
-            // Throw an error
+            unsigned int token = *in++;
+            size_t literalLength = token >> 4;
+            if(!ReadLengthBytes(in, inEnd, literalLength))
+                return 0;
+            if(literalLength > (size_t)(inEnd - in) || literalLength > (size_t)(outEnd - out))
+                return 0;
+            memcpy(out, in, literalLength);
+            in += literalLength;
+            out += literalLength;
+
+            // The last sequence has no match
+            if(in == inEnd)
+                break;
+
+            if(inEnd - in < 2)
+                return 0;
+            size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+            in += 2;
+            if(offset == 0 || offset > (size_t)(out - dst))
+                return 0;
+
+            size_t matchLength = token & 15;
+            if(!ReadLengthBytes(in, inEnd, matchLength))
+                return 0;
+            matchLength += 4;
+            if(matchLength > (size_t)(outEnd - out))
+                return 0;
+
+            // Byte by byte since the match can overlap what it's writing
+            const unsigned char* match = out - offset;
+            for(size_t i = 0; i < matchLength; i++)
+                out[i] = match[i];
+            out += matchLength;
         }
 
-        fs.close();
+        return (size_t)(out - dst);
+    }
 
-        // Formats the new name of the file
-        newFilename.erase(0, 10);
-        newFilename.erase(std::remove_if(newFilename.begin(), newFilename.end(), isspace), newFilename.end());
-        std::replace(newFilename.begin(), newFilename.end(), ':', '-');
-        newFilename = "log_" + newFilename + ".txt";
+    static bool ReadLengthBytes(const unsigned char*& in, const unsigned char* inEnd, size_t& length)
+    {
+        if(length < 15)
+            return true;
+
+        unsigned char byte;
+        do
+        {
+            if(in >= inEnd)
+                return false;
+            byte = *in++;
+            length += byte;
+        } while(byte == 255);
 
-        // Renames and copies the file into the past_logs directory
-        std::string newFileLocation = pastLogsFilepath + newFilename;
-        std::filesystem::copy(latestLogFilepath, newFileLocation, std::filesystem::copy_options::update_existing);
+        return true;
     }
 
-    static void CreateLoggingDirectories()
+    static void WriteFixed32(char* out, uint32_t value)
     {
-        std::filesystem::create_directory(logsFilepath);
-        std::filesystem::create_directory(pastLogsFilepath);
+        for(int i = 0; i < 4; i++)
+            out[i] = (char)(value >> (i * 8));
     }
 
-    static tm* GetTime()
+    static uint32_t ReadFixed32(const char* in)
     {
-        time_t now = std::time(nullptr);
-        return std::localtime(&now);
+        uint32_t value = 0;
+        for(int i = 3; i >= 0; i--)
+            value = (value << 8) | (unsigned char)in[i];
+        return value;
     }
 
-    static unsigned long long GetFileCreationTime(const char* filePath)
+    // Reads the creation date from the first line of a log, falls back to the last modification time
+    static time_t ReadCreationTime(const std::string& filepath)
     {
-        if(!std::filesystem::exists(filePath))
+        char firstLine[64] = {};
+        std::ifstream file(filepath, std::ios::binary);
+        file.getline(firstLine, sizeof(firstLine));
+
+        tm t{};
+        if(sscanf(firstLine, "Created - %d. %d. %d. %d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec) == 6)
         {
-            return 0;
+            t.tm_year -= 1900;
+            t.tm_mon -= 1;
+            t.tm_isdst = -1;
+            return std::mktime(&t);
         }
-#ifdef PLATY_WINDOWS
-        WIN32_FILE_ATTRIBUTE_DATA fileData;
-        FILETIME fileTime;
-        ULARGE_INTEGER lInt;
 
-        GetFileAttributesExA(filePath, GetFileExInfoStandard, &fileData);
-        fileTime = fileData.ftCreationTime;
-        lInt.LowPart = fileTime.dwLowDateTime;
-        lInt.HighPart = fileTime.dwHighDateTime;
+        std::error_code error;
+        auto lastWrite = std::filesystem::last_write_time(filepath, error);
+        if(error)
+            return std::time(nullptr);
+        auto sinceNow = std::chrono::duration_cast<std::chrono::system_clock::duration>(lastWrite - std::filesystem::file_time_type::clock::now());
+        return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() + sinceNow);
+    }
+
+    static void CreateLoggingDirectories()
+    {
+        std::error_code error;
+        std::filesystem::create_directory(logsFilepath, error);
+        std::filesystem::create_directory(pastLogsFilepath, error);
+        loggingDirectoriesCreated = true;
+    }
+
+    static const char* LevelName(int logLevel)
+    {
+        switch(logLevel)
+        {
+            case LOGLEVEL_TRACE: return "Trace";
+            case LOGLEVEL_INFO: return "Info";
+            case LOGLEVEL_DEBUG: return "Debug";
+            case LOGLEVEL_WARNING: return "Warning";
+            case LOGLEVEL_ERROR: return "Error";
+            case LOGLEVEL_FATAL: return "Fatal";
+            default: return "Unknown";
+        }
+    }
 
-        return lInt.QuadPart;
+    // Thread safe replacement for std::localtime
+    static tm GetTime(time_t time)
+    {
+        tm result{};
+#ifdef PLATY_WINDOWS
+        localtime_s(&result, &time);
 #else
-        printf("fuck you no unix support");
-         return 0;
+        localtime_r(&time, &result);
 #endif
+        return result;
     }
 
-    static unsigned long long GetFileCreationTime(const std::filesystem::path& filePath)
+    static uint64_t GetTimestamp()
     {
-        return GetFileCreationTime(filePath.string().c_str());
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
     }
 
-    static std::filesystem::path GetOldestLog()
+    // Writes "[HH:MM:SS(.fraction)] <Level>" into header, returns its length
+    // The HH:MM:SS digits are cached and only recomputed when the second changes
+    static size_t FormatHeader(char* header, uint64_t timestamp, const char* logLevelStr, unsigned int precision)
     {
-        std::filesystem::path oldestFile;
-        for(const std::filesystem::path file : std::filesystem::directory_iterator(pastLogsFilepath))
+        struct SecondCache
+        {
+            uint64_t second = UINT64_MAX;
+            char digits[8];
+        };
+        static thread_local SecondCache cache;
+
+        uint64_t second = timestamp / 1000000000;
+        if(second != cache.second)
         {
-            if(GetFileCreationTime(oldestFile) > GetFileCreationTime(file) || GetFileCreationTime(oldestFile) == 0)
+            tm t;
+#ifndef PLATY_WINDOWS
+            // localtime takes a lock, the crash handler uses the offset from the last time it was called instead
+            if(emergencyFlushing.load(std::memory_order_relaxed))
+            {
+                uint64_t local = (uint64_t)((int64_t)second + utcOffset.load(std::memory_order_relaxed)) % 86400;
+                t.tm_hour = (int)(local / 3600);
+                t.tm_min = (int)(local / 60 % 60);
+                t.tm_sec = (int)(local % 60);
+            }
+            else
             {
-                oldestFile = file;
+                t = GetTime((time_t)second);
+                utcOffset.store(t.tm_gmtoff, std::memory_order_relaxed);
             }
+#else
+            t = GetTime((time_t)second);
+#endif
+            cache.digits[0] = (char)('0' + t.tm_hour / 10);
+            cache.digits[1] = (char)('0' + t.tm_hour % 10);
+            cache.digits[2] = ':';
+            cache.digits[3] = (char)('0' + t.tm_min / 10);
+            cache.digits[4] = (char)('0' + t.tm_min % 10);
+            cache.digits[5] = ':';
+            cache.digits[6] = (char)('0' + t.tm_sec / 10);
+            cache.digits[7] = (char)('0' + t.tm_sec % 10);
+            cache.second = second;
         }
-        return oldestFile;
-    }
 
-    static unsigned int CountFiles(const char* directory)
-    {
-        unsigned int fileCount = 0;
-        std::filesystem::directory_iterator dir(directory);
-        for(const auto& e : dir)
+        char* out = header;
+        *out++ = '[';
+        memcpy(out, cache.digits, 8);
+        out += 8;
+
+        int fractionDigits = precision == TIMESTAMP_MILLISECONDS ? 3 : precision == TIMESTAMP_MICROSECONDS ? 6 : 0;
+        if(fractionDigits > 0)
         {
-            if(e.is_regular_file())
-                fileCount++;
+            uint64_t fraction = (timestamp % 1000000000) / (fractionDigits == 3 ? 1000000 : 1000);
+            *out++ = '.';
+            for(int i = fractionDigits - 1; i >= 0; i--)
+            {
+                out[i] = (char)('0' + fraction % 10);
+                fraction /= 10;
+            }
+            out += fractionDigits;
         }
 
-        return fileCount;
+        *out++ = ']';
+        *out++ = ' ';
+        *out++ = '<';
+        size_t levelLength = strlen(logLevelStr);
+        memcpy(out, logLevelStr, levelLength);
+        out += levelLength;
+        *out++ = '>';
+        *out = '\0';
+
+        return (size_t)(out - header);
     }
 };
 
 
+// Logging macros, compile to nothing when the level is below PLATY_MIN_LEVEL or not in PLATY_COMPILED_LEVELS
+#define PLATY_LOG_AT(logLevel, function, ...) do { if constexpr(Logger::IsLevelCompiled(logLevel)) Logger::function(__VA_ARGS__); } while(0)
+#define PLATY_TRACE(...) PLATY_LOG_AT(Logger::LOGLEVEL_TRACE, Trace, __VA_ARGS__)
+#define PLATY_INFO(...) PLATY_LOG_AT(Logger::LOGLEVEL_INFO, Info, __VA_ARGS__)
+#define PLATY_DEBUG(...) PLATY_LOG_AT(Logger::LOGLEVEL_DEBUG, Debug, __VA_ARGS__)
+#define PLATY_WARNING(...) PLATY_LOG_AT(Logger::LOGLEVEL_WARNING, Warning, __VA_ARGS__)
+#define PLATY_ERROR(...) PLATY_LOG_AT(Logger::LOGLEVEL_ERROR, Error, __VA_ARGS__)
+#define PLATY_FATAL(...) PLATY_LOG_AT(Logger::LOGLEVEL_FATAL, Fatal, __VA_ARGS__)
+
+// Sampling macros, every call site counts on its own: every nth call, the first n calls or at most one call per interval
+#define PLATY_LOG_SAMPLED(logLevel, function, Counter, counterType, limit, ...) do { if constexpr(Logger::IsLevelCompiled(logLevel)) { \
+    static std::atomic<counterType> platyCounter{0}; if(Logger::Counter(platyCounter, limit)) Logger::function(__VA_ARGS__); } } while(0)
+#define PLATY_LOG_EVERY_N(logLevel, function, n, ...) PLATY_LOG_SAMPLED(logLevel, function, EveryN, uint64_t, n, __VA_ARGS__)
+#define PLATY_LOG_FIRST_N(logLevel, function, n, ...) PLATY_LOG_SAMPLED(logLevel, function, FirstN, uint64_t, n, __VA_ARGS__)
+#define PLATY_LOG_EVERY_T(logLevel, function, interval, ...) PLATY_LOG_SAMPLED(logLevel, function, EveryInterval, int64_t, interval, __VA_ARGS__)
+#define PLATY_TRACE_EVERY_N(n, ...) PLATY_LOG_EVERY_N(Logger::LOGLEVEL_TRACE, Trace, n, __VA_ARGS__)
+#define PLATY_INFO_EVERY_N(n, ...) PLATY_LOG_EVERY_N(Logger::LOGLEVEL_INFO, Info, n, __VA_ARGS__)
+#define PLATY_DEBUG_EVERY_N(n, ...) PLATY_LOG_EVERY_N(Logger::LOGLEVEL_DEBUG, Debug, n, __VA_ARGS__)
+#define PLATY_WARNING_EVERY_N(n, ...) PLATY_LOG_EVERY_N(Logger::LOGLEVEL_WARNING, Warning, n, __VA_ARGS__)
+#define PLATY_ERROR_EVERY_N(n, ...) PLATY_LOG_EVERY_N(Logger::LOGLEVEL_ERROR, Error, n, __VA_ARGS__)
+#define PLATY_FATAL_EVERY_N(n, ...) PLATY_LOG_EVERY_N(Logger::LOGLEVEL_FATAL, Fatal, n, __VA_ARGS__)
+#define PLATY_TRACE_FIRST_N(n, ...) PLATY_LOG_FIRST_N(Logger::LOGLEVEL_TRACE, Trace, n, __VA_ARGS__)
+#define PLATY_INFO_FIRST_N(n, ...) PLATY_LOG_FIRST_N(Logger::LOGLEVEL_INFO, Info, n, __VA_ARGS__)
+#define PLATY_DEBUG_FIRST_N(n, ...) PLATY_LOG_FIRST_N(Logger::LOGLEVEL_DEBUG, Debug, n, __VA_ARGS__)
+#define PLATY_WARNING_FIRST_N(n, ...) PLATY_LOG_FIRST_N(Logger::LOGLEVEL_WARNING, Warning, n, __VA_ARGS__)
+#define PLATY_ERROR_FIRST_N(n, ...) PLATY_LOG_FIRST_N(Logger::LOGLEVEL_ERROR, Error, n, __VA_ARGS__)
+#define PLATY_FATAL_FIRST_N(n, ...) PLATY_LOG_FIRST_N(Logger::LOGLEVEL_FATAL, Fatal, n, __VA_ARGS__)
+#define PLATY_TRACE_EVERY_T(interval, ...) PLATY_LOG_EVERY_T(Logger::LOGLEVEL_TRACE, Trace, interval, __VA_ARGS__)
+#define PLATY_INFO_EVERY_T(interval, ...) PLATY_LOG_EVERY_T(Logger::LOGLEVEL_INFO, Info, interval, __VA_ARGS__)
+#define PLATY_DEBUG_EVERY_T(interval, ...) PLATY_LOG_EVERY_T(Logger::LOGLEVEL_DEBUG, Debug, interval, __VA_ARGS__)
+#define PLATY_WARNING_EVERY_T(interval, ...) PLATY_LOG_EVERY_T(Logger::LOGLEVEL_WARNING, Warning, interval, __VA_ARGS__)
+#define PLATY_ERROR_EVERY_T(interval, ...) PLATY_LOG_EVERY_T(Logger::LOGLEVEL_ERROR, Error, interval, __VA_ARGS__)
+#define PLATY_FATAL_EVERY_T(interval, ...) PLATY_LOG_EVERY_T(Logger::LOGLEVEL_FATAL, Fatal, interval, __VA_ARGS__)
+
+
 #ifdef PLATY_WINDOWS
     HANDLE Logger::console = GetStdHandle(STD_OUTPUT_HANDLE);
     unsigned const int Logger::traceColor = FOREGROUND_GREEN | FOREGROUND_RED | FOREGROUND_BLUE;
@@ -294,12 +4014,12 @@ private:
     unsigned const int Logger::fatalColor = FOREGROUND_RED;
 #else
     void* Logger::console = nullptr;
-    unsigned int Logger::traceColor = 0;
-    unsigned int Logger::infoColor = 0;
-    unsigned int Logger::debugColor = 0;
-    unsigned int Logger::warnColor = 0;
-    unsigned int Logger::errorColor = 0;
-    unsigned int Logger::fatalColor = 0;
+    unsigned const int Logger::traceColor = 0;
+    unsigned const int Logger::infoColor = 0;
+    unsigned const int Logger::debugColor = 0;
+    unsigned const int Logger::warnColor = 0;
+    unsigned const int Logger::errorColor = 0;
+    unsigned const int Logger::fatalColor = 0;
 #endif
 
 
@@ -307,10 +4027,108 @@ const std::string Logger::latestLogFilepath = "./logs/latest_log.txt";
 const std::string Logger::logsFilepath = "./logs";
 const std::string Logger::pastLogsFilepath = "./logs/past_logs/";
 bool Logger::shouldCreateNewFile = true;
+bool Logger::loggingDirectoriesCreated = false;
 unsigned int Logger::pastLogsToKeep = 5;
+time_t Logger::currentFileCreated = 0;
+std::set<Logger::ArchivedLog> Logger::archiveIndex;
+bool Logger::archiveIndexLoaded = false;
+uint64_t Logger::archiveBytes = 0;
+
+uint64_t Logger::retentionBytes = UINT64_MAX;
+std::chrono::seconds Logger::retentionAge = std::chrono::seconds(0);
+uint64_t Logger::minimumFreeSpace = 0;
+
+bool Logger::archiveCompression = false;
+std::thread Logger::compressionThread;
+std::mutex Logger::compressionMutex;
+std::condition_variable Logger::compressionCondition;
+std::deque<Logger::ArchivedLog> Logger::compressionJobs;
+std::atomic<bool> Logger::compressionRunning = false;
+
+uint64_t Logger::rotationSize = 0;
+unsigned int Logger::rotationInterval = ROTATE_NONE;
+uint64_t Logger::fileBytesWritten = 0;
+uint64_t Logger::rotateAtBytes = UINT64_MAX;
+uint64_t Logger::rotateAtTime = UINT64_MAX;
 
 std::mutex Logger::mutex = std::mutex();
 std::fstream Logger::fs = std::fstream();
+std::vector<char> Logger::fileBuffer;
+unsigned int Logger::fileSink = FILESINK_STREAM;
+unsigned int Logger::openFileSink = FILESINK_STREAM;
+int Logger::logFile = -1;
+uint64_t Logger::fileOffset = 0;
+#ifdef PLATY_IO_URING
+Logger::IoUring Logger::uring;
+std::vector<std::vector<char>> Logger::uringBuffers;
+#endif
+char* Logger::mmapWindow = nullptr;
+char* Logger::mmapNextWindow = nullptr;
+size_t Logger::mmapWindowSize = 16 * 1024 * 1024;
+uint64_t Logger::mmapWindowOffset = 0;
+uint64_t Logger::mmapLength = 0;
+size_t Logger::fileBufferCapacity = 64 * 1024;
+size_t Logger::fileBufferUsed = 0;
+unsigned int Logger::timestampPrecision = TIMESTAMP_SECONDS;
+std::atomic<unsigned int> Logger::fileFormat = FILEFORMAT_TEXT;
+unsigned int Logger::openFileFormat = FILEFORMAT_TEXT;
+std::unordered_map<const char*, uint64_t> Logger::binaryFormatIds;
+std::vector<std::string> Logger::binaryFormats;
+uint64_t Logger::lastBinaryTimestamp = 0;
+unsigned int Logger::flushPolicy = FLUSH_EVERY_LINE | FLUSH_ON_ERROR;
+size_t Logger::flushBytes = 0;
+std::chrono::milliseconds Logger::flushInterval = std::chrono::milliseconds(0);
+std::chrono::steady_clock::time_point Logger::lastFileFlush;
+
+std::atomic<unsigned int> Logger::logLevelsToDisplay = LOGLEVEL_ALL;
+std::atomic<unsigned int> Logger::logLevelsToSave = LOGLEVEL_ALL;
+std::atomic<unsigned int> Logger::enabledLevels = LOGLEVEL_ALL;
+std::atomic<Logger::FlightHeader*> Logger::flightRecorder = nullptr;
+std::atomic<unsigned int> Logger::flightRecorderLevels = LOGLEVEL_NONE;
+
+std::unique_ptr<Logger::QueueCell[]> Logger::queue;
+size_t Logger::queueMask = 0;
+alignas(64) std::atomic<size_t> Logger::enqueuePos = 0;
+alignas(64) std::atomic<size_t> Logger::dequeuePos = 0;
+
+std::atomic<bool> Logger::usePerThreadBuffers = false;
+size_t Logger::threadBufferMask = 0;
+std::mutex Logger::threadBuffersMutex;
+std::vector<std::unique_ptr<Logger::ThreadBuffer>> Logger::threadBuffers;
+std::atomic<uint64_t> Logger::threadBuffersGeneration = 0;
+size_t Logger::flushingThreads = 0;
+std::mutex Logger::threadOwnersMutex;
+std::vector<Logger::ThreadBufferOwner*> Logger::threadOwners;
+thread_local Logger::ThreadBufferOwner Logger::threadBufferOwner;
+
+std::thread Logger::initThread;
+
+std::atomic<bool> Logger::asyncEnabled = false;
+std::atomic<size_t> Logger::asyncProducers = 0;
+std::atomic<bool> Logger::writerRunning = false;
+std::atomic<unsigned int> Logger::overflowPolicies[levelCount] = {};
+std::atomic<uint64_t> Logger::droppedMessages[levelCount] = {};
+std::chrono::steady_clock::time_point Logger::lastDropReport;
+std::atomic<bool> Logger::emergencyFlushing = false;
+std::atomic<bool> Logger::writerParked = false;
+#ifndef PLATY_WINDOWS
+struct sigaction Logger::previousCrashHandlers[sizeof(crashSignals) / sizeof(crashSignals[0])];
+int Logger::emergencyFile = -1;
+uint64_t Logger::emergencyFormats = 0;
+std::atomic<long> Logger::utcOffset = 0;
+std::atomic<bool> Logger::crashHandlerInstalled = false;
+thread_local Logger::CrashStack Logger::crashStack;
+#endif
+std::atomic<bool> Logger::deferredFormatting = false;
+bool Logger::suppressDuplicates = false;
+uint64_t Logger::lastRecordHash = 0;
+int Logger::lastRecordLevel = LOGLEVEL_NONE;
+const char* Logger::lastRecordLevelStr = nullptr;
+unsigned int Logger::lastRecordColor = 0;
+uint64_t Logger::repeatedRecords = 0;
+uint64_t Logger::repeatsSince = 0;
+uint64_t Logger::lastRepeatTimestamp = 0;
+std::thread Logger::writerThread;
 
-unsigned int Logger::logLevelsToDisplay = LOGLEVEL_ALL;
-unsigned int Logger::logLevelsToSave = LOGLEVEL_ALL;
+// Defined last so it is destroyed first
+Logger::ShutdownGuard Logger::shutdownGuard;
@@ -0,0 +1,126 @@
+// The per message path of the logger before it was reworked, kept to compare the benchmarks against
+// It writes to ./baseline_logs so it doesn't touch the files of the current logger
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+namespace Baseline
+{
+    inline std::mutex mutex;
+    inline std::fstream fs;
+    inline const std::string logsFilepath = "./baseline_logs/";
+    inline const std::string pastLogsFilepath = "./baseline_logs/past_logs/";
+    inline const std::string latestLogFilepath = "./baseline_logs/latest_log.txt";
+
+    inline tm* GetTime()
+    {
+        time_t now = std::time(nullptr);
+        return std::localtime(&now);
+    }
+
+    // Three localtime calls for one header like the old Log
+    inline void FormatHeader(char* header, const char* logLevelStr)
+    {
+        sprintf(header, "[%i:%i:%i] <%s>", GetTime()->tm_hour, GetTime()->tm_min, GetTime()->tm_sec, logLevelStr);
+    }
+
+    // Checks both directories and opens and closes the file for every line
+    inline void LogToFile(const char* header, const char* message)
+    {
+        if(!std::filesystem::exists(logsFilepath) || !std::filesystem::exists(pastLogsFilepath))
+        {
+            std::filesystem::create_directory(logsFilepath);
+            std::filesystem::create_directory(pastLogsFilepath);
+        }
+
+        fs.open(latestLogFilepath, std::ios::app);
+        if(fs.is_open())
+            fs << header << " - " << message << "\n";
+        fs.close();
+    }
+
+    // Arguments by value and sprintf into fixed buffers
+    template<typename... Args>
+    void Log(const char* logLevelStr, const char* message, Args... format)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        char header[32], messageBuffer[1000];
+        FormatHeader(header, logLevelStr);
+        sprintf(messageBuffer, message, format...);
+        LogToFile(header, messageBuffer);
+    }
+
+    // The old public functions took the arguments by value too and passed them on by value
+    template<typename... Args>
+    void Info(const char* message, Args... format)
+    {
+        Log("INFO", message, format...);
+    }
+
+    // Archives latest_log.txt by reading its first line for the name and copying the whole file into past_logs
+    inline void SaveLatestLog()
+    {
+        std::string newFilename;
+        fs.open(latestLogFilepath);
+        if(fs.is_open())
+            std::getline(fs, newFilename);
+        fs.close();
+
+        newFilename.erase(0, 10);
+        newFilename.erase(std::remove_if(newFilename.begin(), newFilename.end(), isspace), newFilename.end());
+        std::replace(newFilename.begin(), newFilename.end(), ':', '-');
+        newFilename = "log_" + newFilename + ".txt";
+
+        std::filesystem::copy(latestLogFilepath, pastLogsFilepath + newFilename, std::filesystem::copy_options::update_existing);
+    }
+
+    // Stands in for the old GetFileCreationTime, which checked that the file exists and then read its time
+    inline unsigned long long GetFileCreationTime(const std::filesystem::path& filePath)
+    {
+        std::error_code error;
+        if(!std::filesystem::exists(filePath, error))
+            return 0;
+        return (unsigned long long)std::filesystem::last_write_time(filePath, error).time_since_epoch().count();
+    }
+
+    inline std::filesystem::path GetOldestLog()
+    {
+        std::filesystem::path oldestFile;
+        for(const std::filesystem::path& file : std::filesystem::directory_iterator(pastLogsFilepath))
+        {
+            if(GetFileCreationTime(oldestFile) > GetFileCreationTime(file) || GetFileCreationTime(oldestFile) == 0)
+                oldestFile = file;
+        }
+        return oldestFile;
+    }
+
+    inline unsigned int CountFiles(const char* directory)
+    {
+        unsigned int fileCount = 0;
+        for(const auto& e : std::filesystem::directory_iterator(directory))
+        {
+            if(e.is_regular_file())
+                fileCount++;
+        }
+        return fileCount;
+    }
+
+    // Scans past_logs twice to remove the oldest one when it's full, like the old SaveLatestLog before archiving
+    inline void RemoveOldestIfFull(unsigned int pastLogsToKeep)
+    {
+        if(CountFiles(pastLogsFilepath.c_str()) >= pastLogsToKeep)
+            std::filesystem::remove(GetOldestLog());
+    }
+
+    inline void Clear()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(logsFilepath, error);
+    }
+}
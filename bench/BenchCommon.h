@@ -0,0 +1,75 @@
+// Shared helpers of the benchmarks: timing, percentiles and a clean log directory
+#pragma once
+
+#include "../PlatyLogger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <vector>
+
+#ifndef PLATY_WINDOWS
+#include <time.h>
+#endif
+
+namespace Bench
+{
+    using Clock = std::chrono::steady_clock;
+
+    inline double SecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    inline double NanosecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+    // CPU time of the calling thread, the wall clock elsewhere. Leaves out the time other threads, like the writer,
+    // run on the same core
+    inline double ThreadNanoseconds()
+    {
+#ifndef PLATY_WINDOWS
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+#else
+        return std::chrono::duration<double, std::nano>(Clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // Sorts the samples, p is between 0 and 1
+    inline double Percentile(std::vector<double>& samples, double p)
+    {
+        if(samples.empty())
+            return 0;
+        std::sort(samples.begin(), samples.end());
+        size_t index = std::min(samples.size() - 1, (size_t)(p * (double)samples.size()));
+        return samples[index];
+    }
+
+    // Numeric command line argument or the default
+    inline long Argument(int argc, char** argv, int index, long fallback)
+    {
+        return argc > index ? std::atol(argv[index]) : fallback;
+    }
+
+    // Starts every run with an empty ./logs so archiving the previous run isn't measured
+    inline void ClearLogs()
+    {
+        std::error_code error;
+        std::filesystem::remove_all("./logs", error);
+    }
+
+    // Quiet logger writing only to the file, flushed when the buffer is full
+    inline Logger::Config FileOnlyConfig()
+    {
+        Logger::Config config;
+        config.levelsToDisplay = Logger::LOGLEVEL_NONE;
+        config.flushPolicy = Logger::FLUSH_ON_ERROR;
+        return config;
+    }
+}
@@ -0,0 +1,83 @@
+// Archiving with 10,000 past logs kept: scanning past_logs for every archive like the old logger against the
+// retention index, which is loaded once and pruned without touching the directory
+// The logger prints a line for every past log it removes, the numbers come after them
+// Usage: bench_archive_retention [past logs] [archived logs to time]
+
+#include "BenchCommon.h"
+#include "Baseline.h"
+
+#include <fstream>
+
+// Past logs one minute apart, named like ArchiveLog names them
+static void WritePastLogs(const std::string& directory, long count)
+{
+    std::filesystem::create_directories(directory);
+    time_t first = 1577836800; // 2020-01-01
+    for(long i = 0; i < count; i++)
+    {
+        time_t created = first + i * 60;
+        tm t{};
+        localtime_r(&created, &t);
+        char filename[64];
+        sprintf(filename, "log_%04i.%02i.%02i.%02i-%02i-%02i.txt", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+        std::ofstream(directory + filename) << "Archived log\n";
+    }
+}
+
+static double RunBaseline(long pastLogs, long archives)
+{
+    Baseline::Clear();
+    WritePastLogs(Baseline::pastLogsFilepath, pastLogs);
+
+    auto start = Bench::Clock::now();
+    for(long i = 0; i < archives; i++)
+    {
+        Baseline::RemoveOldestIfFull((unsigned int)pastLogs);
+        std::ofstream(Baseline::pastLogsFilepath + "log_new_" + std::to_string(i) + ".txt") << "Archived log\n";
+    }
+    double seconds = Bench::SecondsSince(start);
+
+    Baseline::Clear();
+    return seconds / (double)archives;
+}
+
+static double Run(long pastLogs, long archives, double& initSeconds)
+{
+    Bench::ClearLogs();
+    WritePastLogs("./logs/past_logs/", pastLogs);
+
+    Logger::Config config = Bench::FileOnlyConfig();
+    config.pastLogsToKeep = (unsigned int)pastLogs;
+    // Every message goes over the limit, so each one archives the log it was written to
+    config.rotationSize = 1;
+
+    auto start = Bench::Clock::now();
+    Logger::Init(config);
+    initSeconds = Bench::SecondsSince(start);
+
+    start = Bench::Clock::now();
+    for(long i = 0; i < archives; i++)
+        Logger::Info("Message %ld", i);
+    Logger::Flush();
+    double seconds = Bench::SecondsSince(start);
+
+    Logger::SetRotationSize(0);
+    Bench::ClearLogs();
+    return seconds / (double)archives;
+}
+
+int main(int argc, char** argv)
+{
+    long pastLogs = Bench::Argument(argc, argv, 1, 10000);
+    long archives = Bench::Argument(argc, argv, 2, 200);
+
+    double baseline = RunBaseline(pastLogs, archives);
+    double initSeconds = 0;
+    double indexed = Run(pastLogs, archives, initSeconds);
+
+    std::printf("%ld past logs, %ld archived logs\n", pastLogs, archives);
+    std::printf("%-34s %12s\n", "retention", "ms/archive");
+    std::printf("%-34s %12.3f\n", "scan past_logs for every archive", baseline * 1000);
+    std::printf("%-34s %12.3f\n", "index", indexed * 1000);
+    std::printf("loading the index at startup: %.3f ms\n", initSeconds * 1000);
+}
@@ -0,0 +1,40 @@
+// CPU time per logging call of one thread: synchronous Log against the async queue formatting on the caller
+// and deferred formatting, where the caller only copies the arguments
+// Usage: bench_deferred [messages] [queue and thread buffer size]
+
+#include "BenchCommon.h"
+
+static double Run(long messages, size_t bufferSize, bool async, bool threadBuffers, bool deferred)
+{
+    Bench::ClearLogs();
+    Logger::Config config = Bench::FileOnlyConfig();
+    config.asyncQueueSize = async ? bufferSize : 0;
+    config.threadBufferSize = threadBuffers ? bufferSize : 0;
+    config.deferredFormatting = deferred;
+    Logger::Init(config);
+
+    // Sets up the thread buffer and touches every slot of the queue or buffer once
+    for(size_t i = 0; i < bufferSize; i++)
+        Logger::Info("Warming up %zu", i);
+    double start = Bench::ThreadNanoseconds();
+    for(long i = 0; i < messages; i++)
+        Logger::Info("Order %ld filled at %.2f for account %s, %d items", i, 101.25, "ACC-1042", 3);
+    double nanoseconds = (Bench::ThreadNanoseconds() - start) / (double)messages;
+
+    Logger::DisableAsyncLogging();
+    Logger::Flush();
+    return nanoseconds;
+}
+
+int main(int argc, char** argv)
+{
+    long messages = Bench::Argument(argc, argv, 1, 500000);
+    size_t bufferSize = (size_t)Bench::Argument(argc, argv, 2, 16384);
+
+    std::printf("%ld messages, queue and thread buffers of %zu\n", messages, bufferSize);
+    std::printf("%-34s %10s\n", "mode", "ns/call");
+    std::printf("%-34s %10.1f\n", "sync Log", Run(messages, bufferSize, false, false, false));
+    std::printf("%-34s %10.1f\n", "async queue, formatted by caller", Run(messages, bufferSize, true, false, false));
+    std::printf("%-34s %10.1f\n", "async queue, deferred", Run(messages, bufferSize, true, false, true));
+    std::printf("%-34s %10.1f\n", "thread buffer, deferred", Run(messages, bufferSize, true, true, true));
+}
@@ -0,0 +1,51 @@
+// Lines per second written to the log file by one thread, opening and closing the file per line like the old
+// logger and with the persistent buffered writer under each flush policy
+// Usage: bench_file_throughput [lines] [directory, tmpfs by default]
+
+#include "BenchCommon.h"
+#include "Baseline.h"
+
+static const char* const line = "Request %ld handled in %.3f ms by worker %d";
+
+static double RunBaseline(long lines)
+{
+    Baseline::Clear();
+    auto start = Bench::Clock::now();
+    for(long i = 0; i < lines; i++)
+        Baseline::Info(line, i, 1.25, 3);
+    return (double)lines / Bench::SecondsSince(start);
+}
+
+static double Run(long lines, unsigned int flushPolicy, size_t flushBytes)
+{
+    Bench::ClearLogs();
+    Logger::Config config = Bench::FileOnlyConfig();
+    config.flushPolicy = flushPolicy;
+    config.flushBytes = flushBytes;
+    Logger::Init(config);
+
+    auto start = Bench::Clock::now();
+    for(long i = 0; i < lines; i++)
+        Logger::Info(line, i, 1.25, 3);
+    Logger::Flush();
+    return (double)lines / Bench::SecondsSince(start);
+}
+
+int main(int argc, char** argv)
+{
+    long lines = Bench::Argument(argc, argv, 1, 200000);
+    std::filesystem::path directory = argc > 2 ? argv[2] : "/dev/shm";
+    directory /= "platy_bench_" + std::to_string(std::time(nullptr));
+    std::filesystem::create_directories(directory);
+    std::filesystem::current_path(directory);
+
+    std::printf("%ld lines in %s\n", lines, directory.string().c_str());
+    std::printf("%-30s %14s\n", "writer", "lines/s");
+    std::printf("%-30s %14.0f\n", "open and close per line", RunBaseline(lines));
+    std::printf("%-30s %14.0f\n", "flush every line", Run(lines, Logger::FLUSH_EVERY_LINE, 0));
+    std::printf("%-30s %14.0f\n", "flush every 64 KB", Run(lines, Logger::FLUSH_EVERY_N_BYTES, 64 * 1024));
+    std::printf("%-30s %14.0f\n", "flush when the buffer is full", Run(lines, Logger::FLUSH_ON_ERROR, 0));
+
+    std::filesystem::current_path(directory.parent_path());
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,60 @@
+// Latency of the first message when the previous run left a big latest_log.txt: copying it into past_logs like the
+// old logger against renaming it
+// Usage: bench_first_log [size of the previous log in MB]
+
+#include "BenchCommon.h"
+#include "Baseline.h"
+
+#include <fstream>
+
+static void WritePreviousLog(const std::string& directory, const std::string& filepath, long megabytes)
+{
+    std::filesystem::create_directories(directory + "past_logs");
+    std::ofstream file(filepath, std::ios::binary);
+    file << "Created - 2026. 1. 2. 3:4:5\n";
+
+    std::string chunk;
+    while(chunk.size() < 1024 * 1024)
+        chunk += "[03:04:05] <Info> - Request handled in 1.250 ms by worker 3\n";
+    chunk.resize(1024 * 1024);
+    for(long i = 0; i < megabytes; i++)
+        file.write(chunk.data(), (std::streamsize)chunk.size());
+}
+
+static double RunBaseline(long megabytes)
+{
+    Baseline::Clear();
+    WritePreviousLog(Baseline::logsFilepath, Baseline::latestLogFilepath, megabytes);
+
+    auto start = Bench::Clock::now();
+    Baseline::SaveLatestLog();
+    Baseline::Info("First message");
+    double seconds = Bench::SecondsSince(start);
+
+    Baseline::Clear();
+    return seconds;
+}
+
+static double Run(long megabytes)
+{
+    Bench::ClearLogs();
+    WritePreviousLog("./logs/", "./logs/latest_log.txt", megabytes);
+
+    auto start = Bench::Clock::now();
+    Logger::Init(Bench::FileOnlyConfig());
+    Logger::Info("First message");
+    Logger::Flush();
+    double seconds = Bench::SecondsSince(start);
+
+    Bench::ClearLogs();
+    return seconds;
+}
+
+int main(int argc, char** argv)
+{
+    long megabytes = Bench::Argument(argc, argv, 1, 1024);
+    std::printf("previous log of %ld MB\n", megabytes);
+    std::printf("%-10s %14s\n", "archiving", "first log ms");
+    std::printf("%-10s %14.3f\n", "copy", RunBaseline(megabytes) * 1000);
+    std::printf("%-10s %14.3f\n", "rename", Run(megabytes) * 1000);
+}
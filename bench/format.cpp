@@ -0,0 +1,55 @@
+// Cost of formatting one message with the logger's formatter against the sprintf the logger used before
+// Usage: bench_format [messages]
+
+#include "BenchCommon.h"
+
+struct LoggerBenchmark
+{
+    template<typename... Args>
+    static size_t Format(char* buffer, size_t bufferSize, const char* format, const Args&... args)
+    {
+        Logger::FormatBuffer out(buffer, bufferSize);
+        Logger::FormatArg formatArgs[sizeof...(Args) + 1] = {Logger::MakeFormatArg(args)...};
+        Logger::FormatMessage(out, format, formatArgs, sizeof...(Args));
+        out.Terminate();
+        return out.size;
+    }
+};
+
+// Keeps the compiler from dropping the formatted messages
+static volatile char sink;
+
+template<typename... Args>
+static void Compare(const char* name, long messages, const char* format, const Args&... args)
+{
+    char buffer[1000];
+
+    auto start = Bench::Clock::now();
+    for(long i = 0; i < messages; i++)
+    {
+        sprintf(buffer, format, args...);
+        sink = buffer[0];
+    }
+    double sprintfTime = Bench::NanosecondsSince(start) / (double)messages;
+
+    start = Bench::Clock::now();
+    for(long i = 0; i < messages; i++)
+    {
+        LoggerBenchmark::Format(buffer, sizeof(buffer), format, args...);
+        sink = buffer[0];
+    }
+    double formatTime = Bench::NanosecondsSince(start) / (double)messages;
+
+    std::printf("%-12s %12.1f %12.1f\n", name, sprintfTime, formatTime);
+}
+
+int main(int argc, char** argv)
+{
+    long messages = Bench::Argument(argc, argv, 1, 2000000);
+    std::printf("%-12s %12s %12s\n", "message", "sprintf ns", "Logger ns");
+    Compare("text", messages, "Connection accepted");
+    Compare("integers", messages, "Request %d of user %lu took %u ms", 1234567, 9876543210ul, 42u);
+    Compare("doubles", messages, "Position %.3f %.3f %.3f", 12.5, -3.25, 1024.125);
+    Compare("strings", messages, "User %s opened %s", "alice", "/var/lib/data/report.csv");
+    Compare("mixed", messages, "[%08x] %-10s %5d %.2f%%", 0xbeefu, "worker", 17, 99.5);
+}
@@ -0,0 +1,55 @@
+// Cost of formatting one message header: the old sprintf with three localtime calls against the cached digits
+// Usage: bench_header_format [headers]
+
+#include "BenchCommon.h"
+#include "Baseline.h"
+
+struct LoggerBenchmark
+{
+    static size_t FormatHeader(char* header, uint64_t timestamp, unsigned int precision)
+    {
+        return Logger::FormatHeader(header, timestamp, "Info", precision);
+    }
+
+    static uint64_t GetTimestamp()
+    {
+        return Logger::GetTimestamp();
+    }
+};
+
+// Keeps the compiler from dropping the formatted headers
+static volatile char sink;
+
+static double RunBaseline(long headers)
+{
+    char header[32];
+    auto start = Bench::Clock::now();
+    for(long i = 0; i < headers; i++)
+    {
+        Baseline::FormatHeader(header, "Info");
+        sink = header[1];
+    }
+    return Bench::NanosecondsSince(start) / (double)headers;
+}
+
+static double Run(long headers, unsigned int precision)
+{
+    char header[64];
+    auto start = Bench::Clock::now();
+    for(long i = 0; i < headers; i++)
+    {
+        LoggerBenchmark::FormatHeader(header, LoggerBenchmark::GetTimestamp(), precision);
+        sink = header[1];
+    }
+    return Bench::NanosecondsSince(start) / (double)headers;
+}
+
+int main(int argc, char** argv)
+{
+    long headers = Bench::Argument(argc, argv, 1, 2000000);
+    std::printf("%-36s %10s\n", "header", "ns/header");
+    std::printf("%-36s %10.1f\n", "sprintf, localtime three times", RunBaseline(headers));
+    std::printf("%-36s %10.1f\n", "cached digits, seconds", Run(headers, Logger::TIMESTAMP_SECONDS));
+    std::printf("%-36s %10.1f\n", "cached digits, milliseconds", Run(headers, Logger::TIMESTAMP_MILLISECONDS));
+    std::printf("%-36s %10.1f\n", "cached digits, microseconds", Run(headers, Logger::TIMESTAMP_MICROSECONDS));
+}
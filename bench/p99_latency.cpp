@@ -0,0 +1,60 @@
+// Latency of single logging calls with 16 producer threads, synchronous and through the async queue
+// Usage: bench_p99_latency [messages per thread] [queue size]
+
+#include "BenchCommon.h"
+
+#include <thread>
+
+static const int threadCount = 16;
+
+static void Run(const char* name, long messages, size_t queueSize, unsigned int flushPolicy)
+{
+    Bench::ClearLogs();
+    Logger::Config config = Bench::FileOnlyConfig();
+    config.flushPolicy = flushPolicy;
+    config.asyncQueueSize = queueSize;
+    Logger::Init(config);
+
+    std::vector<std::vector<double>> latencies(threadCount);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([t, messages, &latencies]
+        {
+            std::vector<double>& samples = latencies[t];
+            samples.reserve(messages);
+            for(long i = 0; i < messages; i++)
+            {
+                auto start = Bench::Clock::now();
+                Logger::Info("Request %ld handled by thread %d in %.3f ms", i, t, 1.25);
+                samples.push_back(Bench::NanosecondsSince(start));
+            }
+        });
+    }
+    for(auto& thread : threads)
+        thread.join();
+
+    Logger::DisableAsyncLogging();
+    Logger::Flush();
+
+    std::vector<double> all;
+    for(auto& samples : latencies)
+        all.insert(all.end(), samples.begin(), samples.end());
+    double p50 = Bench::Percentile(all, 0.5);
+    double p99 = Bench::Percentile(all, 0.99);
+    double p999 = Bench::Percentile(all, 0.999);
+    std::printf("%-28s %12.0f %12.0f %12.0f\n", name, p50, p99, p999);
+}
+
+int main(int argc, char** argv)
+{
+    long messages = Bench::Argument(argc, argv, 1, 20000);
+    size_t queueSize = (size_t)Bench::Argument(argc, argv, 2, 65536);
+
+    std::printf("%d threads, %ld messages each, latency in ns\n", threadCount, messages);
+    std::printf("%-28s %12s %12s %12s\n", "mode", "p50", "p99", "p99.9");
+    Run("sync, flush every line", messages, 0, Logger::FLUSH_EVERY_LINE | Logger::FLUSH_ON_ERROR);
+    Run("sync, buffered", messages, 0, Logger::FLUSH_ON_ERROR);
+    Run("async queue", messages, queueSize, Logger::FLUSH_ON_ERROR);
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+}
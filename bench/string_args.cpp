@@ -0,0 +1,69 @@
+// Logging std::string arguments: taken by value twice like the old Info and Log did, against forwarding them
+// Usage: bench_string_args [messages] [string length]
+
+#include "BenchCommon.h"
+
+#include <string>
+
+// std::string that counts its copies, formatted through PlatyFormat
+struct CountedString
+{
+    static inline long copies = 0;
+    std::string text;
+
+    explicit CountedString(std::string value) : text(std::move(value)) {}
+    CountedString(const CountedString& other) : text(other.text) { copies++; }
+};
+
+static void PlatyFormat(Logger::FormatBuffer& out, const CountedString& value)
+{
+    out.Append(value.text.data(), value.text.size());
+}
+
+// The old signatures: Info and Log both took Args... format by value
+template<typename... Args>
+static void LogByValue(const char* message, Args... format)
+{
+    Logger::Info(message, format...);
+}
+
+template<typename... Args>
+static void InfoByValue(const char* message, Args... format)
+{
+    LogByValue(message, format...);
+}
+
+template<typename LogFunction>
+static void Run(const char* name, long messages, const CountedString& user, const std::string& path, LogFunction log)
+{
+    Bench::ClearLogs();
+    Logger::Init(Bench::FileOnlyConfig());
+    CountedString::copies = 0;
+
+    auto start = Bench::Clock::now();
+    for(long i = 0; i < messages; i++)
+        log(user, path);
+    Logger::Flush();
+    double nanoseconds = Bench::NanosecondsSince(start) / (double)messages;
+
+    std::printf("%-14s %10.1f %14.2f\n", name, nanoseconds, (double)CountedString::copies / (double)messages);
+}
+
+int main(int argc, char** argv)
+{
+    long messages = Bench::Argument(argc, argv, 1, 500000);
+    size_t length = (size_t)Bench::Argument(argc, argv, 2, 256);
+    CountedString user(std::string(length, 'u'));
+    std::string path(length, 'p');
+
+    std::printf("%ld messages with two %zu character strings\n", messages, length);
+    std::printf("%-14s %10s %14s\n", "arguments", "ns/call", "copies/arg");
+    Run("by value", messages, user, path, [](const CountedString& user, const std::string& path)
+    {
+        InfoByValue("User %s opened %s", user, path);
+    });
+    Run("forwarded", messages, user, path, [](const CountedString& user, const std::string& path)
+    {
+        Logger::Info("User %s opened %s", user, path);
+    });
+}
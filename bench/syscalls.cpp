@@ -0,0 +1,102 @@
+// System calls per logged line, counted with ptrace: checking the directories and opening and closing the file for
+// every line like the old logger against the persistent writer. Linux only, single threaded
+// Usage: bench_syscalls [lines]
+
+#include "BenchCommon.h"
+#include "Baseline.h"
+
+#include <csignal>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+enum Mode
+{
+    MODE_BASELINE,
+    MODE_FLUSH_EVERY_LINE,
+    MODE_BUFFERED
+};
+
+static void Setup(Mode mode)
+{
+    if(mode == MODE_BASELINE)
+    {
+        Baseline::Clear();
+        Baseline::Info("First message");
+        return;
+    }
+
+    Bench::ClearLogs();
+    Logger::Config config = Bench::FileOnlyConfig();
+    config.flushPolicy = mode == MODE_FLUSH_EVERY_LINE ? Logger::FLUSH_EVERY_LINE : Logger::FLUSH_ON_ERROR;
+    Logger::Init(config);
+    Logger::Info("First message");
+}
+
+static void LogLines(Mode mode, long lines)
+{
+    for(long i = 0; i < lines; i++)
+    {
+        if(mode == MODE_BASELINE)
+            Baseline::Info("Request %ld handled in %.3f ms", i, 1.25);
+        else
+            Logger::Info("Request %ld handled in %.3f ms", i, 1.25);
+    }
+    if(mode != MODE_BASELINE)
+        Logger::Flush();
+}
+
+// Runs LogLines in a traced child and counts the system calls it makes between two SIGSTOPs
+static long CountSyscalls(Mode mode, long lines)
+{
+    pid_t child = fork();
+    if(child == 0)
+    {
+        Setup(mode);
+        ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+        raise(SIGSTOP);
+        LogLines(mode, lines);
+        raise(SIGSTOP);
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    ptrace(PTRACE_SETOPTIONS, child, nullptr, (void*)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+
+    // Syscall stops come in pairs, one on entry and one on exit
+    long stops = 0;
+    while(true)
+    {
+        ptrace(PTRACE_SYSCALL, child, nullptr, nullptr);
+        if(waitpid(child, &status, 0) < 0 || !WIFSTOPPED(status))
+            break;
+        if(WSTOPSIG(status) == (SIGTRAP | 0x80))
+            stops++;
+        else if(WSTOPSIG(status) == SIGSTOP)
+            break;
+    }
+
+    kill(child, SIGKILL);
+    waitpid(child, &status, 0);
+    return (stops + 1) / 2;
+}
+
+int main(int argc, char** argv)
+{
+    long lines = Bench::Argument(argc, argv, 1, 10000);
+
+    std::printf("%ld lines\n", lines);
+    std::printf("%-30s %12s %14s\n", "writer", "syscalls", "syscalls/line");
+    const char* names[] = {"open and close per line", "flush every line", "flush when the buffer is full"};
+    for(Mode mode : {MODE_BASELINE, MODE_FLUSH_EVERY_LINE, MODE_BUFFERED})
+    {
+        // The calls raise makes to stop the child are counted in both, logging nothing leaves only them
+        long overhead = CountSyscalls(mode, 0);
+        long syscalls = CountSyscalls(mode, lines) - overhead;
+        std::printf("%-30s %12ld %14.3f\n", names[mode], syscalls, (double)syscalls / (double)lines);
+    }
+
+    Baseline::Clear();
+    Bench::ClearLogs();
+}
@@ -0,0 +1,42 @@
+// Producer throughput with 1 to 64 logging threads, through the shared queue and through per thread buffers
+// Usage: bench_thread_scaling [messages per thread]
+
+#include "BenchCommon.h"
+
+#include <thread>
+
+static double Run(int threadCount, long messages, bool threadBuffers)
+{
+    Bench::ClearLogs();
+    Logger::Init(Bench::FileOnlyConfig());
+    if(threadBuffers)
+        Logger::EnableAsyncLogging(8192, 4096);
+    else
+        Logger::EnableAsyncLogging(8192);
+
+    std::vector<std::thread> threads;
+    auto start = Bench::Clock::now();
+    for(int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([t, messages]
+        {
+            for(long i = 0; i < messages; i++)
+                Logger::Info("Thread %d processed item %ld", t, i);
+        });
+    }
+    for(auto& thread : threads)
+        thread.join();
+    double seconds = Bench::SecondsSince(start);
+
+    Logger::DisableAsyncLogging();
+    return (double)messages * threadCount / seconds;
+}
+
+int main(int argc, char** argv)
+{
+    long messages = Bench::Argument(argc, argv, 1, 100000);
+    std::printf("%-8s %18s %18s\n", "threads", "queue msg/s", "thread buf msg/s");
+    for(int threads = 1; threads <= 64; threads *= 2)
+        std::printf("%-8d %18.0f %18.0f\n", threads, Run(threads, messages, false), Run(threads, messages, true));
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+}
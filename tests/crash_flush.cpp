@@ -0,0 +1,129 @@
+// Kills a process with a crash signal in the middle of a burst of messages and checks that every message whose
+// logging call had returned made it into the log file exactly once, for each buffering mode and file sink
+// POSIX only, every mode runs in a forked child inside its own temporary directory
+
+#include "../PlatyLogger.h"
+
+#include <sys/wait.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+struct Mode
+{
+    const char* name;
+    size_t queueSize;
+    size_t threadBufferSize;
+    unsigned int fileSink;
+    int signal;
+};
+
+static const Mode modes[] = {
+    {"sync stream", 0, 0, Logger::FILESINK_STREAM, SIGSEGV},
+    {"sync mmap", 0, 0, Logger::FILESINK_MMAP, SIGBUS},
+    {"sync io_uring", 0, 0, Logger::FILESINK_URING, SIGABRT},
+    {"queue stream", 1 << 16, 0, Logger::FILESINK_STREAM, SIGSEGV},
+    {"queue mmap", 1 << 16, 0, Logger::FILESINK_MMAP, SIGABRT},
+    {"thread buffers stream", 1024, 1 << 16, Logger::FILESINK_STREAM, SIGSEGV},
+    {"thread buffers io_uring", 1024, 1 << 16, Logger::FILESINK_URING, SIGILL},
+};
+
+// Number of messages the child must have acknowledged before it is killed
+static constexpr uint64_t killAfter = 50000;
+
+[[noreturn]] static void RunChild(const Mode& mode, std::atomic<uint64_t>* acknowledged)
+{
+    Logger::Config config;
+    config.levelsToDisplay = Logger::LOGLEVEL_NONE;
+    config.flushPolicy = Logger::FLUSH_ON_ERROR;
+    config.fileBufferSize = 1 << 20;
+    config.fileSink = mode.fileSink;
+    Logger::Init(config);
+    if(mode.queueSize > 0)
+        Logger::EnableAsyncLogging(mode.queueSize, mode.threadBufferSize);
+    Logger::InstallCrashHandler();
+
+    // Keeps logging until the parent kills it, a message counts once the call returned
+    for(uint64_t i = 0;; i++)
+    {
+        Logger::Info("record %llu", (unsigned long long)i);
+        acknowledged->store(i + 1, std::memory_order_release);
+    }
+}
+
+static bool CheckLog(const std::string& path, uint64_t acknowledged, std::string& problem)
+{
+    std::ifstream in(path);
+    std::vector<unsigned char> seen(acknowledged, 0);
+    std::string line;
+    while(std::getline(in, line))
+    {
+        size_t found = line.find("- record ");
+        if(found == std::string::npos)
+            continue;
+        uint64_t number = std::strtoull(line.c_str() + found + 9, nullptr, 10);
+        if(number < acknowledged && ++seen[number] > 1)
+        {
+            problem = "record " + std::to_string(number) + " written twice";
+            return false;
+        }
+    }
+
+    for(uint64_t i = 0; i < acknowledged; i++)
+    {
+        if(seen[i] == 0)
+        {
+            problem = "acknowledged record " + std::to_string(i) + " missing";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool RunMode(const Mode& mode)
+{
+    char directory[] = "/tmp/platy_crash_flush_XXXXXX";
+    if(mkdtemp(directory) == nullptr)
+        return false;
+
+    auto* acknowledged = (std::atomic<uint64_t>*)mmap(nullptr, sizeof(std::atomic<uint64_t>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    new(acknowledged) std::atomic<uint64_t>(0);
+
+    pid_t child = fork();
+    if(child == 0)
+    {
+        if(chdir(directory) != 0)
+            _exit(2);
+        RunChild(mode, acknowledged);
+    }
+
+    while(acknowledged->load(std::memory_order_acquire) < killAfter)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    kill(child, mode.signal);
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    uint64_t total = acknowledged->load(std::memory_order_acquire);
+    munmap(acknowledged, sizeof(std::atomic<uint64_t>));
+
+    std::string problem;
+    bool killed = WIFSIGNALED(status) && WTERMSIG(status) == mode.signal;
+    bool passed = killed && CheckLog(std::string(directory) + "/logs/latest_log.txt", total, problem);
+    if(!killed)
+        problem = "child wasn't ended by the signal";
+
+    std::cout << (passed ? "PASS " : "FAIL ") << mode.name << ": " << total << " acknowledged" << (passed ? "" : ", " + problem) << std::endl;
+
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    return passed;
+}
+
+int main()
+{
+    bool passed = true;
+    for(const Mode& mode : modes)
+        passed &= RunMode(mode);
+    return passed ? 0 : 1;
+}
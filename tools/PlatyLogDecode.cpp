@@ -0,0 +1,73 @@
+// Turns a binary or compressed (.plz) PlatyLogger log file or a flight recorder file back into the text format
+// Build: g++ -std=c++17 -I.. PlatyLogDecode.cpp -o PlatyLogDecode -pthread
+// Usage: PlatyLogDecode <log file> [output file]
+
+#include "../PlatyLogger.h"
+
+#include <iostream>
+#include <sstream>
+
+static bool Decode(std::istream& in, std::ostream& out)
+{
+    // Flight recorder files are recognized by their header, nothing is written if it doesn't match
+    if(Logger::DecodeFlightRecorder(in, out))
+        return true;
+    in.clear();
+    in.seekg(0);
+
+    // Compressed archives are unpacked first, they can hold a text or a binary log
+    if(in.peek() == 'P')
+    {
+        std::stringstream decompressed;
+        if(!Logger::DecompressArchive(in, decompressed))
+            return false;
+        return Decode(decompressed, out);
+    }
+
+    // Text logs only have to be copied
+    std::string creationDate;
+    std::getline(in, creationDate);
+    if(in.peek() != 'P')
+    {
+        out << creationDate << "\n" << in.rdbuf();
+        return true;
+    }
+
+    in.seekg(0);
+    return Logger::DecodeBinaryLog(in, out);
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        printf("Usage: %s <log file> [output file]\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if(!in.is_open())
+    {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    bool decoded;
+    if(argc > 2)
+    {
+        std::ofstream out(argv[2], std::ios::binary);
+        decoded = Decode(in, out);
+    }
+    else
+    {
+        decoded = Decode(in, std::cout);
+    }
+
+    if(!decoded)
+    {
+        printf("%s is not a complete log\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}